@@ -1,256 +1,2464 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <signal.h>
-#include <unistd.h>
-#include <string.h>
-#include <sys/mman.h>
-#include <sys/types.h>
-#include <sys/wait.h>
-#include <time.h>
-#include "shared_memory.h"
-
-// Global variables for shared data and configuration
-extern SharedMemoryData *sharedData;
-extern size_t shared_size;
-volatile sig_atomic_t running = 1;
-int NCPU; // Number of CPUs
-int TSLICE; // Time slice in milliseconds
-int completedProcesses = 0; // Track the number of successfully completed processes
-
-// Function declarations
-void handle_child_termination(int sig);
-void print_job_details();
-void add_to_ready_queue(size_t index);
-size_t get_from_ready_queue();
-void initialize_process_schedule();
-void print_submitted_processes();
-void start_scheduler(SharedMemoryData *data, size_t size, int ncpu, int t_slice);
-
-// Function to add a process index to the ready queue
-void add_to_ready_queue(size_t index) {
-    if (sharedData->readyQueue.readyQueueSize < MAX_PROCESSES) {
-        sharedData->readyQueue.queue[sharedData->readyQueue.readyQueueSize].index = index;
-        sharedData->readyQueue.readyQueueSize++;
-    } else {
-        fprintf(stderr, "Ready queue is full. Cannot add more processes.\n");
-    }
-}
-
-// Function to get a process index from the ready queue
-size_t get_from_ready_queue() {
-    if (sharedData->readyQueue.readyQueueSize == 0) return (size_t)-1;
-
-    size_t index = sharedData->readyQueue.queue[0].index;
-
-    // Shift all processes in the ready queue one position forward
-    for (int i = 1; i < sharedData->readyQueue.readyQueueSize; i++) {
-        sharedData->readyQueue.queue[i - 1] = sharedData->readyQueue.queue[i];
-    }
-    sharedData->readyQueue.readyQueueSize--;
-
-    return index;
-}
-
-// Initialize the ready queue with NCPU processes initially
-void initialize_process_schedule() {
-    int count = 0;
-    for (size_t i = 0; i < shared_size && count < NCPU; i++) {
-        if (sharedData->table[i].pid > 0) {  // Valid process
-            add_to_ready_queue(i);
-
-            count++;
-            if(sharedData->table[i].isRunning==false){
-                sharedData->table[i].pid=-1;
-            }
-        }
-    }
-    sharedData->readyQueue.submittedProcess=count;
-}
-
-
-
-// Signal handler for child processes
-void signal_handler(int signum) {
-    if (signum == SIGSTOP) {
-        // Child process should handle stopping logic if needed
-        printf("Process %d paused.\n", getpid());
-        pause();  // Wait for signals (e.g., SIGCONT) to continue
-    } else if (signum == SIGCONT) {
-        // Child process resumes execution
-        printf("Process %d resumed.\n", getpid());
-    }
-}
-
-void start_scheduler(SharedMemoryData *data, size_t size, int ncpu, int t_slice) {
-    printf("Starting round-robin scheduler...\n");
-
-    sharedData = data;
-    shared_size = size;
-    NCPU = ncpu;
-    TSLICE = t_slice;
-
-    initialize_process_schedule();
-
-    printf("Ready Queue Size after initialization: %d\n", sharedData->readyQueue.readyQueueSize);
-
-    while (completedProcesses < sharedData->readyQueue.submittedProcess) {
-        int anyProcessScheduled = 0;
-        int status;  // Declare the status variable here
-
-        for (int i = 0; i < NCPU; i++) {
-            size_t index = get_from_ready_queue();
-            if (sharedData->readyQueue.readyQueueSize == 0) {
-                printf("No processes in the ready queue.\n");
-                break;
-            }
-
-            if (index >= shared_size) {
-                fprintf(stderr, "Invalid index: %zu\n", index);
-                continue;
-            }
-
-            ProcessInfo *process = &sharedData->table[index];
-
-            // Check if process needs to be started or resumed
-            if (process->pid == -1) {  // Only fork if the process has not started
-                process->pid = getpid();
-                process->isRunning = true;
-                printf("Forking for process: %s\n", process->executableName);
-                pid_t pid = fork();
-
-                if (pid < 0) {
-                    perror("Fork failed");
-                    continue;
-                }
-
-                if (pid == 0) {  // Child process
-                    // Set up signal handler
-                    signal(SIGSTOP, signal_handler);
-                    signal(SIGCONT, signal_handler);
-                    
-                    process->start_time = time(NULL);
-                    char *args[2];  // Adjust the size based on the number of arguments
-                    args[0] = process->executableName; // First argument is the program name
-                    args[1] = NULL; // Null-terminated array
-
-                    printf("Executing: %s\n", args[0]);
-                    execvp(args[0], args);
-                    perror("Execution failed");
-                    exit(EXIT_FAILURE);
-                } else {
-                    process->pid = pid;  // Store child PID in the parent process
-                    printf("Child PID for %s is %d\n", process->executableName, process->pid);
-                }
-            }
-
-            if (process->pid > 0 && process->isRunning) {  // Process is already created and assigned a PID
-                anyProcessScheduled = 1;
-
-                // Resume the process
-                kill(process->pid, SIGCONT);  // Send SIGCONT to the child process
-
-                // Update the wait time before the process runs
-                time_t currentTime = time(NULL);
-                process->wait_time += currentTime - process->lastPausedTime;
-
-                // Let the process run for the specified time slice
-                struct timespec ts;
-                ts.tv_sec = TSLICE / 1000;
-                ts.tv_nsec = (TSLICE % 1000) * 1000000;
-                nanosleep(&ts, NULL);
-
-                // After the time slice, pause the process if still running
-                kill(process->pid, SIGSTOP);  // Send SIGSTOP to the child process
-                process->lastPausedTime = currentTime;
-
-                // Check if process completed within the time slice
-                pid_t result = waitpid(process->pid, &status, WNOHANG);
-                if (result == -1) {
-                    perror("waitpid failed");
-                    continue;
-                } else if (result == 0) {
-                    // The process is still running; re-queue it
-                    printf("Process %s is still running, re-queuing.\n", process->executableName);
-                    process->remaining_time -= TSLICE;
-                    add_to_ready_queue(index);
-                } else if (result > 0) {
-                    if (WIFEXITED(status)) {
-                        printf("Process %s exited normally with status %d\n", process->executableName, WEXITSTATUS(status));
-                        completedProcesses++;
-                        process->end_time = time(NULL); // Set completion time
-                        // process->pid = -1; // You can reset this if needed
-                    } else {
-                        // If it was stopped or terminated, consider re-queuing as needed
-                        printf("Process %s did not exit normally, re-queuing.\n", process->executableName);
-                        process->remaining_time -= TSLICE;
-                        add_to_ready_queue(index);
-                    }
-                }
-            }
-        }
-
-        if (!anyProcessScheduled) {
-            printf("No processes could be scheduled in this cycle.\n");
-            break;
-        }
-    }
-
-    if (completedProcesses == sharedData->readyQueue.submittedProcess) {
-        printf("All processes completed successfully.\n");
-    } else {
-        printf("Scheduler finished but not all processes were completed.\n");
-    }
-}
-
-
-
-
-// Function to handle child termination
-void handle_child_termination(int sig) {
-    int status;
-    pid_t pid;
-    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
-        for (size_t i = 0; i < shared_size; i++) {
-            if (sharedData->table[i].pid == pid) {
-                sharedData->table[i].isRunning = false;
-                sharedData->table[i].completion_time += TSLICE;
-                sharedData->table[i].end_time = time(NULL);
-                double execTime = difftime(sharedData->table[i].end_time, sharedData->table[i].start_time);
-                printf("Execution Time for process %s (PID: %d): %.2f seconds\n", sharedData->table[i].executableName, pid, execTime);
-                completedProcesses++;
-                printf("Process %s (PID: %d) completed.\n", sharedData->table[i].executableName, pid);
-                break;
-            }
-        }
-    }
-}
-
-// Function to print job details after scheduling
-void print_job_details() {
-    printf("\nJob Details:\n");
-    printf("--------------------------------------------------------------------------------------------------\n");
-    printf("| Name              | PID     | Completion Time  | Wait Time |   Arrival Time  |\n");
-    printf("--------------------------------------------------------------------------------------------------\n");
-    int totalWaitTime = 0;
-    int totalCompletionTime = 0;
-    for (size_t i = 0; i < shared_size; i++) {
-        if (sharedData->table[i].pid > 0) {
-            ProcessInfo *process = &sharedData->table[i];
-            int waitTime = process->wait_time;
-            int completionTime = process->completion_time;
-            int arrivalTime = (int)process->arrival_time;
-            totalWaitTime += waitTime;
-            totalCompletionTime += completionTime;
-            printf("| %-16s | %-7d | %-15d | %-9d |  %9d  |\n", process->executableName, process->pid, completionTime, waitTime, arrivalTime);
-        }
-    }
-    printf("--------------------------------------------------------------------------------------------------\n");
-    if (completedProcesses > 0) {
-        float avgWaitTime = (float)totalWaitTime / completedProcesses;
-        float avgCompletionTime = (float)totalCompletionTime / completedProcesses;
-        printf("Average Wait Time: %.2f ms\n", avgWaitTime);
-        printf("Average Completion Time: %.2f ms\n", avgCompletionTime);
-    } else {
-        printf("No processes completed.\n");
-    }
-}
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sched.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
+#include <sys/syscall.h>
+#include <errno.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <sys/ptrace.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include "shared_memory.h"
+#include "scheduler.h"
+#include "burst_history.h"
+#include "journal.h"
+#include "instrument.h"
+
+// Global variables for shared data and configuration
+volatile sig_atomic_t running = 1;
+int NCPU; // Number of CPUs
+int TSLICE; // Time slice in milliseconds
+_Atomic int completedProcesses = 0; // Track the number of successfully completed processes
+int verbosity = LOG_SUMMARY;
+const char *burstHistoryPath = NULL;
+const char *journalPath = NULL;
+int schedulerWakeFd = -1;
+
+// Function declarations
+void handle_child_termination(int sig);
+void print_job_details();
+void add_to_ready_queue(size_t index);
+size_t get_from_ready_queue();
+void initialize_process_schedule();
+void print_submitted_processes();
+void start_scheduler(SharedMemoryData *data, size_t size, int ncpu, int t_slice);
+
+static _Thread_local int currentSlot = -1;  // Slot of the per-CPU dispatcher thread, -1 on the main thread
+
+#ifdef SCHED_INSTRUMENT
+// Progress messages are timed as a phase of their own
+#undef log_at
+#define log_at(level, ...) do { \
+        if (verbosity >= (level)) { \
+            INSTRUMENT_BEGIN(logStart); \
+            printf(__VA_ARGS__); \
+            INSTRUMENT_END(logStart, currentSlot, PHASE_LOG); \
+        } \
+    } while (0)
+#endif
+
+static pthread_mutex_t traceLock = PTHREAD_MUTEX_INITIALIZER;  // Per-CPU dispatchers append concurrently
+
+// Only per-CPU dispatch updates the trace ring and the live statistics from
+// several threads; the single-threaded loops take no lock for them
+static int shared_writers(void) {
+    return sharedData->dispatchMode == DISPATCH_PERCPU;
+}
+
+// Append an event to the trace ring when tracing is enabled
+static void trace_event(int type, size_t index, uint64_t ns) {
+    TraceRing *trace = &sharedData->traceRing;
+    if (!trace->enabled) return;
+
+    int locked = shared_writers();
+    if (locked) pthread_mutex_lock(&traceLock);
+    uint64_t count = atomic_load_explicit(&trace->count, memory_order_relaxed);
+    TraceEvent *event = &trace->events[count & (TRACE_RING_SIZE - 1)];
+    event->ns = ns;
+    event->index = (uint32_t)index;
+    event->slot = job_last_slots()[index];
+    event->type = (uint8_t)type;
+    atomic_store_explicit(&trace->count, count + 1, memory_order_release);
+    if (locked) pthread_mutex_unlock(&traceLock);
+}
+
+// Let a job run, or stop it, through the backend; instrumented builds time
+// these into the job's slot and count its perf events in between
+static void resume_job(size_t index) {
+    INSTRUMENT_BEGIN(start);
+#ifdef SCHED_INSTRUMENT
+    if (perfEventsEnabled) perf_job_enable(index);
+#endif
+    schedBackend->resume(index);
+    INSTRUMENT_END(start, job_last_slots()[index], PHASE_RESUME);
+}
+
+static void stop_job(size_t index) {
+    INSTRUMENT_BEGIN(start);
+    schedBackend->stop(index);
+#ifdef SCHED_INSTRUMENT
+    if (perfEventsEnabled) perf_job_disable(index);
+#endif
+    INSTRUMENT_END(start, job_last_slots()[index], PHASE_STOP);
+}
+
+// Live statistics. Each update runs between stats_begin() and stats_end(),
+// which keep the sequence count odd while it is in progress. Per-CPU
+// dispatchers update them concurrently, so there writers also take statsLock.
+static size_t slotJob[MAX_NCPU];  // Job whose slice each slot's busy time is counting
+static pthread_mutex_t statsLock = PTHREAD_MUTEX_INITIALIZER;
+static _Atomic int percpuQueued;  // Jobs in the per-CPU run queues
+
+static void stats_begin(LiveStats *stats) {
+    if (shared_writers()) pthread_mutex_lock(&statsLock);
+    atomic_fetch_add_explicit(&stats->seq, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+static void stats_end(LiveStats *stats) {
+    stats->readyJobs = (uint32_t)(sharedData->dispatchMode == DISPATCH_PERCPU ? percpuQueued
+                                                                             : sharedData->readyQueue.readyQueueSize);
+    atomic_fetch_add_explicit(&stats->seq, 1, memory_order_release);
+    if (shared_writers()) pthread_mutex_unlock(&statsLock);
+}
+
+// A job was resumed on the slot it is bound to
+static void stats_slot_start(size_t index, uint64_t now) {
+    LiveStats *stats = &sharedData->liveStats;
+    int slot = job_last_slots()[index];
+    if (slot < 0) return;
+
+    stats_begin(stats);
+    stats->slotSince[slot] = now;
+    stats_end(stats);
+    slotJob[slot] = index;
+}
+
+// A job's slice ended, by preemption or exit
+static void stats_slot_stop(size_t index, uint64_t now) {
+    LiveStats *stats = &sharedData->liveStats;
+    int slot = job_last_slots()[index];
+    if (slot < 0 || slotJob[slot] != index || stats->slotSince[slot] == 0) return;
+
+    stats_begin(stats);
+    stats->slotBusyNs[slot] += now - stats->slotSince[slot];
+    stats->slotSince[slot] = 0;
+    stats_end(stats);
+}
+
+static void stats_job_done(size_t index) {
+    LiveStats *stats = &sharedData->liveStats;
+    ProcessInfo *process = job_info(index);
+
+    stats_slot_stop(index, process->end_time);
+    stats_begin(stats);
+    stats->completed++;
+    stats->waitHist[stats_bucket(process->wait_time / 1000)]++;
+    stats->turnaroundHist[stats_bucket((process->end_time - process->arrival_time) / 1000)]++;
+    stats_end(stats);
+}
+
+// A job's submitted priority, clamping out-of-range values
+static int clamped_priority(size_t index) {
+    int priority = job_priorities()[index];
+    if (priority < MIN_PRIORITY) priority = MIN_PRIORITY;
+    if (priority > MAX_PRIORITY) priority = MAX_PRIORITY;
+    return priority;
+}
+
+// Map a job onto its ready ring: its MLFQ level under MLFQ, otherwise its priority
+static int ready_level(size_t index) {
+    if (sharedData->policy == POLICY_MLFQ) {
+        return job_levels()[index];
+    }
+    return clamped_priority(index) - MIN_PRIORITY;
+}
+
+// Stride scheduling: a job's tickets, and the pass it adds per full slice
+static int stride_tickets(size_t index) {
+    return clamped_priority(index) * STRIDE_TICKETS_PER_PRIORITY;
+}
+
+static uint64_t stride_of(size_t index) {
+    return STRIDE_ONE / stride_tickets(index);
+}
+
+static void ring_push(int level, size_t index) {
+    ReadyRing *ring = &sharedData->readyQueue.rings[level];
+
+    // A job sits in at most one ring, so a ring never holds more than jobCapacity entries
+    ready_slots(level)[ring->tail] = (uint32_t)index;
+    if (++ring->tail == sharedData->jobCapacity) ring->tail = 0;
+    ring->count++;
+    sharedData->readyQueue.nonEmptyMask |= 1u << level;
+    sharedData->readyQueue.readyQueueSize++;
+}
+
+static size_t ring_pop(int level) {
+    ReadyRing *ring = &sharedData->readyQueue.rings[level];
+
+    size_t index = ready_slots(level)[ring->head];
+    if (++ring->head == sharedData->jobCapacity) ring->head = 0;
+    ring->count--;
+    if (ring->count == 0) {
+        sharedData->readyQueue.nonEmptyMask &= ~(1u << level);
+    }
+    sharedData->readyQueue.readyQueueSize--;
+
+    return index;
+}
+
+// Policies that order the ready queue by a per-job key instead of by level
+static int uses_heap(void) {
+    return sharedData->policy == POLICY_SRTF || sharedData->policy == POLICY_EDF ||
+           sharedData->policy == POLICY_STRIDE;
+}
+
+// Heap-ordered policies under which a ready job with a smaller key takes a
+// running job's slot before its slice ends
+static int preempts_on_key(void) {
+    return sharedData->policy == POLICY_SRTF || sharedData->policy == POLICY_EDF;
+}
+
+// Stride: pass of the job picked last. The smallest pass in the system never
+// decreases, so this is the virtual time new jobs join at.
+static uint64_t strideGlobalPass;
+
+// Policies that predict each job's burst from its executable's history: SRTF
+// orders jobs by it, and EDF leaves it in job_remaining() for the shell's
+// admission control
+static int predicts_bursts(void) {
+    return sharedData->policy == POLICY_SRTF || sharedData->policy == POLICY_EDF;
+}
+
+// Heap order: smaller key first, earlier submission on equal keys
+static int heap_before(uint32_t a, uint32_t b) {
+    uint64_t keyA = job_keys()[a], keyB = job_keys()[b];
+    return keyA != keyB ? keyA < keyB : a < b;
+}
+
+static void heap_push(size_t index) {
+    uint32_t *heap = ready_heap();
+    uint32_t pos = sharedData->readyQueue.heapCount++;
+
+    // Sift up: move parents down until the new entry's place is found
+    while (pos > 0 && heap_before((uint32_t)index, heap[(pos - 1) / 2])) {
+        heap[pos] = heap[(pos - 1) / 2];
+        pos = (pos - 1) / 2;
+    }
+    heap[pos] = (uint32_t)index;
+    sharedData->readyQueue.readyQueueSize++;
+}
+
+static size_t heap_pop(void) {
+    uint32_t *heap = ready_heap();
+    size_t index = heap[0];
+    uint32_t count = --sharedData->readyQueue.heapCount;
+    uint32_t last = heap[count];
+
+    // Sift down: move the smaller child up until the last entry fits
+    uint32_t pos = 0;
+    for (;;) {
+        uint32_t child = 2 * pos + 1;
+        if (child >= count) break;
+        if (child + 1 < count && heap_before(heap[child + 1], heap[child])) child++;
+        if (!heap_before(heap[child], last)) break;
+        heap[pos] = heap[child];
+        pos = child;
+    }
+    heap[pos] = last;
+    sharedData->readyQueue.readyQueueSize--;
+    return index;
+}
+
+// Ordering key of a job under a heap-ordered policy
+static uint64_t policy_key(size_t index) {
+    if (sharedData->policy == POLICY_EDF) {
+        uint64_t deadline = job_info(index)->deadlineNs;
+        return deadline != 0 ? deadline : UINT64_MAX;  // EDF: absolute deadline
+    }
+    if (sharedData->policy == POLICY_STRIDE) return job_info(index)->stridePass;
+    int32_t remaining = job_remaining()[index];
+    return remaining > 0 ? (uint64_t)remaining : 0;  // SRTF: predicted ms left
+}
+
+static void percpu_push(size_t index);
+
+// Function to add a process index to the ready queue
+void add_to_ready_queue(size_t index) {
+    if (sharedData->dispatchMode == DISPATCH_PERCPU) {
+        percpu_push(index);
+        return;
+    }
+    if (uses_heap()) {
+        job_keys()[index] = policy_key(index);
+        heap_push(index);
+        return;
+    }
+    ring_push(ready_level(index), index);
+}
+
+// Function to get a process index from the heap, or from the highest-priority non-empty ring
+size_t get_from_ready_queue() {
+    if (uses_heap()) {
+        if (sharedData->readyQueue.heapCount == 0) return (size_t)-1;
+        size_t index = heap_pop();
+        if (sharedData->policy == POLICY_STRIDE) strideGlobalPass = job_keys()[index];
+        return index;
+    }
+
+    unsigned int mask = sharedData->readyQueue.nonEmptyMask;
+    if (mask == 0) return (size_t)-1;
+
+    return ring_pop(31 - __builtin_clz(mask));
+}
+
+// Time slice in milliseconds for a job's next run. Under MLFQ each level
+// below the top doubles the quantum of the level above it. Adaptive slices
+// then scale that by the job's own factor.
+static int slice_for(size_t index) {
+    int slice = TSLICE;
+    if (sharedData->policy == POLICY_MLFQ) {
+        slice = TSLICE << (MLFQ_TOP_LEVEL - job_levels()[index]);
+    }
+    if (sharedData->sliceMode == SLICE_ADAPTIVE) {
+        int shift = job_info(index)->sliceShift;
+        slice = shift >= 0 ? slice << shift : slice >> -shift;
+        if (slice < 1) slice = 1;
+    }
+    return slice;
+}
+
+// Adaptive slices: after a job is preempted, fold the share of its slice it
+// spent on a CPU into a moving average. A job that keeps using its whole slice
+// is CPU-bound and gets twice the quantum, saving a stop/continue pair per
+// extra slice; one that spends most of its slice blocked gets half, so it
+// hands the slot back sooner.
+static void adapt_slice(size_t index, uint64_t ranNs) {
+    if (sharedData->sliceMode != SLICE_ADAPTIVE || ranNs == 0) return;
+
+    ProcessInfo *process = job_info(index);
+    uint64_t cpuNs = schedBackend->cpu_time(index);
+    if (cpuNs == UINT64_MAX) return;
+
+    double usage = cpuNs > process->lastCpuNs ? (double)(cpuNs - process->lastCpuNs) / ranNs : 0;
+    if (usage > 1) usage = 1;
+    process->lastCpuNs = cpuNs;
+    process->sliceUsage = process->slices <= 1 ? usage : (process->sliceUsage + usage) / 2;
+
+    if (process->sliceUsage >= ADAPTIVE_GROW_USAGE && process->sliceShift < ADAPTIVE_MAX_SHIFT) {
+        process->sliceShift++;
+    } else if (process->sliceUsage < ADAPTIVE_SHRINK_USAGE && process->sliceShift > ADAPTIVE_MIN_SHIFT) {
+        process->sliceShift--;
+    }
+}
+
+// MLFQ priority boost: lift every job back to the top level so long-running
+// jobs that sank to the bottom cannot be starved by a stream of short ones
+static void mlfq_boost(void) {
+    memset(job_levels(), MLFQ_TOP_LEVEL, sharedData->jobCount);
+    for (int level = MLFQ_TOP_LEVEL - 1; level >= 0; level--) {
+        uint32_t count = sharedData->readyQueue.rings[level].count;
+        while (count-- > 0) {
+            ring_push(MLFQ_TOP_LEVEL, ring_pop(level));
+        }
+    }
+}
+
+// Boost once per MLFQ_BOOST_SLICES base slices; lastBoost is in ns
+static void maybe_boost(uint64_t now, uint64_t *lastBoost) {
+    if (sharedData->policy != POLICY_MLFQ) return;
+    if (now - *lastBoost >= (uint64_t)MLFQ_BOOST_SLICES * TSLICE * 1000000ull) {
+        mlfq_boost();
+        *lastBoost = now;
+    }
+}
+
+// End the slice of a job that is still running
+static void note_preempted(size_t index) {
+    log_at(LOG_JOBS, "Process %s is still running, re-queuing.\n", job_info(index)->executableName);
+    trace_event(TRACE_PREEMPT, index, job_info(index)->lastPausedTime);
+    stats_slot_stop(index, job_info(index)->lastPausedTime);
+}
+
+// Put a job, or a gang through its first stage, that used its whole slice back
+// on the ready queue, demoting it under MLFQ
+static void requeue_job(size_t index, int sliceMs) {
+    job_remaining()[index] -= sliceMs;
+    if (sharedData->policy == POLICY_MLFQ && job_levels()[index] > 0) {
+        job_levels()[index]--;
+    }
+
+    // Stride: charge the job for the part of a slice it ran, so preempted and
+    // adaptive slices cost in proportion to their length
+    if (sharedData->policy == POLICY_STRIDE) {
+        job_info(index)->stridePass += stride_of(index) * sliceMs / TSLICE;
+    }
+
+    // SRTF: a job that outlives its estimate is assumed to need as long again
+    ProcessInfo *process = job_info(index);
+    while (sharedData->policy == POLICY_SRTF && job_remaining()[index] <= 0) {
+        job_remaining()[index] += process->estimateMs;
+        process->estimateMs *= 2;
+    }
+    add_to_ready_queue(index);
+}
+
+static void requeue_process(size_t index, int sliceMs) {
+    note_preempted(index);
+    requeue_job(index, sliceMs);
+}
+
+// Gang scheduling. A pipeline submitted as one job becomes a gang: one job
+// per stage, in consecutive table entries, connected by pipes. Only the first
+// stage sits on the ready queue, standing for the whole gang whether or not
+// it is still running itself, and policies see the gang through it. When it is
+// picked, every stage still running gets a slot, and all of them are resumed
+// and stopped together, so no stage waits on a stopped peer with its pipe
+// full or empty. A gang waits for enough free slots rather than running part
+// of its stages.
+
+static int in_gang(size_t index) {
+    return job_info(index)->gangSize > 1;
+}
+
+// Stages of the gang led by leader that have not exited, written to stages; returns how many
+static int gang_stages(size_t leader, size_t *stages) {
+    int count = 0;
+    for (int stage = 0; stage < job_info(leader)->gangSize && count < NCPU; stage++) {
+        if (job_states()[leader + stage] == JOB_RUNNABLE) stages[count++] = leader + stage;
+    }
+    return count;
+}
+
+// The job whose policy state stands for a job or its gang
+static size_t policy_job(size_t index) {
+    return in_gang(index) ? job_info(index)->gangLeader : index;
+}
+
+// Whether two jobs are resumed and stopped as one
+static int same_unit(size_t a, size_t b) {
+    return a == b || (in_gang(a) && in_gang(b) && job_info(a)->gangLeader == job_info(b)->gangLeader);
+}
+
+// After a slice, put each gang among the stopped jobs back on the ready queue
+// once, unless all its stages have exited
+static void requeue_gangs(const size_t *jobs, int count) {
+    size_t stages[NCPU];
+    for (int i = 0; i < count; i++) {
+        if (!in_gang(jobs[i])) continue;
+        int seen = 0;
+        for (int j = 0; j < i && !seen; j++) seen = same_unit(jobs[i], jobs[j]);
+        size_t leader = job_info(jobs[i])->gangLeader;
+        if (!seen && gang_stages(leader, stages) > 0) requeue_job(leader, job_info(jobs[i])->sliceMs);
+    }
+}
+
+// Reset the ready queue, submission ring, trace ring and live statistics; called once before any job is submitted
+void initialize_process_schedule() {
+    memset(&sharedData->readyQueue, 0, sizeof(sharedData->readyQueue));
+    atomic_store(&sharedData->submitRing.head, 0);
+    atomic_store(&sharedData->submitRing.tail, 0);
+    atomic_store(&sharedData->submitRing.arenaHead, 0);
+    sharedData->submitRing.arenaTail = 0;
+    atomic_store(&sharedData->traceRing.count, 0);
+    atomic_store(&sharedData->stopRequested, false);
+    memset(&sharedData->liveStats, 0, sizeof(sharedData->liveStats));
+}
+
+// Arguments, environment and redirections of a job that has not been launched.
+// While its record is being drained, block points into the submission arena;
+// if the launch has to be retried later, it is copied out so the arena space
+// can be reused.
+typedef struct {
+    const char *block;        // Packed strings as in SubmitRecord, NULL for a plain job
+    bool owned;               // block is a heap copy
+    uint16_t argc;
+    uint16_t envc;
+    uint8_t appendStreams;
+} SpawnArgs;
+
+static SpawnArgs *spawnArgs;  // Indexed by job, spawnArgsCapacity entries
+static size_t spawnArgsCapacity;
+
+static SpawnArgs *spawn_args(size_t index) {
+    return index < spawnArgsCapacity && spawnArgs[index].block != NULL ? &spawnArgs[index] : NULL;
+}
+
+// Point a job's spawn arguments at its record's block in the arena. Returns
+// -1 if there is no memory to hold them; the job must then not be spawned, as
+// without them it would be a different command.
+static int set_spawn_args(size_t index, const SubmitRecord *record, const char *arena) {
+    if (index >= spawnArgsCapacity) {
+        size_t capacity = sharedData->jobCapacity;
+        SpawnArgs *grown = realloc(spawnArgs, capacity * sizeof(SpawnArgs));
+        if (grown == NULL) {
+            perror("realloc");
+            return -1;
+        }
+        memset(grown + spawnArgsCapacity, 0, (capacity - spawnArgsCapacity) * sizeof(SpawnArgs));
+        spawnArgs = grown;
+        spawnArgsCapacity = capacity;
+    }
+    SpawnArgs *args = &spawnArgs[index];
+    args->block = arena + (record->argOffset & (SUBMIT_ARENA_SIZE - 1));
+    args->owned = false;
+    args->argc = record->argc;
+    args->envc = record->envc;
+    args->appendStreams = record->appendStreams;
+    return 0;
+}
+
+// Keep a job's block past the drain by copying it out of the arena. Returns
+// -1, with the job's arguments gone, if there is no memory for the copy.
+static int own_spawn_args(size_t index, uint32_t bytes) {
+    SpawnArgs *args = spawn_args(index);
+    if (args == NULL || args->owned) return 0;
+    char *copy = malloc(bytes);
+    if (copy == NULL) {
+        perror("malloc");
+        args->block = NULL;
+        return -1;
+    }
+    memcpy(copy, args->block, bytes);
+    args->block = copy;
+    args->owned = true;
+    return 0;
+}
+
+static void release_spawn_args(size_t index) {
+    SpawnArgs *args = spawn_args(index);
+    if (args == NULL) return;
+    if (args->owned) free((char *)args->block);
+    args->block = NULL;
+}
+
+#define SPAWN_RETRY_MS 1        // Delay before retrying a spawn that failed transiently
+#define SPAWN_RETRY_MAX_MS 100  // Each further failure doubles the delay, up to this
+
+// When each job's spawn may next be tried, 0 if it has not failed; main thread
+// only, sized with the job table by reserve_job_state()
+static uint64_t *spawnRetryAt;
+static uint8_t *spawnFailures;
+static size_t spawnRetryCapacity;
+
+// Whether a queued job's spawn may be tried at now
+static bool spawn_due(size_t index, uint64_t now) {
+    return index >= spawnRetryCapacity || spawnRetryAt[index] <= now;
+}
+
+// Put off the next spawn of a job whose spawn failed transiently
+static void spawn_backoff(size_t index) {
+    if (index >= spawnRetryCapacity) return;  // Retried on the next pass
+    int shift = spawnFailures[index] < 10 ? spawnFailures[index] : 10;
+    uint64_t delayMs = (uint64_t)SPAWN_RETRY_MS << shift;
+    if (delayMs > SPAWN_RETRY_MAX_MS) delayMs = SPAWN_RETRY_MAX_MS;
+    if (spawnFailures[index] < UINT8_MAX) spawnFailures[index]++;
+    spawnRetryAt[index] = schedBackend->now() + delayMs * 1000000ull;
+    log_at(LOG_JOBS, "Spawn of %s failed %d time(s); retrying in %llu ms.\n",
+           job_info(index)->executableName, spawnFailures[index], (unsigned long long)delayMs);
+}
+
+// Create a queued job's process through the backend, tracing the spawn
+static int launch_job(size_t index) {
+    INSTRUMENT_BEGIN(start);
+    int result = schedBackend->launch(index);
+    INSTRUMENT_END(start, currentSlot, PHASE_SPAWN);
+    if (job_states()[index] != JOB_QUEUED) release_spawn_args(index);  // Launched, or failed for good
+    if (result == -1) {
+        if (job_states()[index] == JOB_QUEUED) spawn_backoff(index);
+        return -1;
+    }
+#ifdef SCHED_INSTRUMENT
+    if (perfEventsEnabled) perf_job_open(index);
+#endif
+    trace_event(TRACE_SPAWN, index, schedBackend->now());
+    journal_start(index, job_pids()[index]);  // Durable before the job first runs
+    return 0;
+}
+
+static void fail_launch(size_t index);
+
+// Pipe ends for the stdin and stdout of the gang stage being launched, -1 for none
+static int stagePipe[2] = { -1, -1 };
+
+// Launch every stage of a gang, each reading the previous stage's output. If
+// a stage cannot be spawned the pipeline is broken, so the stages already
+// created are killed and the rest fail; the gang is queued for its survivors
+// to be reaped either way.
+static void launch_gang(size_t leader) {
+    int stageCount = job_info(leader)->gangSize;
+    int input = -1;
+    int stage = 0;
+
+    // A stage that failed before its launch, as for want of memory for its arguments, breaks the pipeline
+    bool intact = true;
+    for (int other = 0; other < stageCount; other++) intact &= job_states()[leader + other] == JOB_QUEUED;
+
+    for (; intact && stage < stageCount; stage++) {
+        int pipeFds[2] = { -1, -1 };
+        if (stage < stageCount - 1 && pipe2(pipeFds, O_CLOEXEC) == -1) {
+            perror("pipe2");
+            break;
+        }
+        stagePipe[0] = input;
+        stagePipe[1] = pipeFds[1];
+        int launched = launch_job(leader + stage);
+        if (input != -1) close(input);
+        if (pipeFds[1] != -1) close(pipeFds[1]);
+        input = pipeFds[0];
+        if (launched == -1) break;
+    }
+    stagePipe[0] = stagePipe[1] = -1;
+    if (input != -1) close(input);
+    if (stage == stageCount) return;
+
+    for (int other = 0; other < stageCount; other++) {
+        size_t index = leader + other;
+        if (job_states()[index] == JOB_RUNNABLE) kill(job_pids()[index], SIGKILL);
+        else if (job_states()[index] == JOB_QUEUED) fail_launch(index);
+    }
+}
+
+// Size the per-job state kept outside the segment for the whole job table.
+// Done by whoever grows the table, so that launching a job never moves that
+// state while per-CPU dispatchers read it.
+static void reserve_job_state(void) {
+    size_t capacity = sharedData->jobCapacity;
+    if (capacity > spawnRetryCapacity) {
+        uint64_t *retryAt = realloc(spawnRetryAt, capacity * sizeof(uint64_t));
+        if (retryAt != NULL) spawnRetryAt = retryAt;
+        uint8_t *failures = retryAt != NULL ? realloc(spawnFailures, capacity) : NULL;
+        if (failures == NULL) {
+            perror("realloc");  // Jobs past the old capacity retry their spawns without backing off
+        } else {
+            spawnFailures = failures;
+            memset(spawnRetryAt + spawnRetryCapacity, 0, (capacity - spawnRetryCapacity) * sizeof(uint64_t));
+            memset(spawnFailures + spawnRetryCapacity, 0, capacity - spawnRetryCapacity);
+            spawnRetryCapacity = capacity;
+        }
+    }
+    cgroup_reserve(capacity);
+#ifdef SCHED_INSTRUMENT
+    if (perfEventsEnabled) perf_jobs_reserve(capacity);
+#endif
+}
+
+// Enter a submission into the job table, queued, and journal it; block holds
+// its strings, if any. Returns its index.
+static size_t enter_job(const SubmitRecord *record, const char *block) {
+    size_t index = sharedData->jobCount++;
+
+    job_states()[index] = JOB_QUEUED;
+    job_priorities()[index] = (int8_t)record->priority;
+    job_remaining()[index] = TSLICE;
+    job_levels()[index] = MLFQ_TOP_LEVEL;
+    job_last_slots()[index] = -1;
+
+    ProcessInfo *process = job_info(index);
+    strcpy(process->executableName, record->executableName);
+    strcpy(process->executablePath, record->executablePath);
+    process->gangLeader = (uint32_t)(index - record->gangStage);
+    process->gangSize = record->gangSize;
+    process->arrival_time = record->arrivalNs;
+    process->lastPausedTime = record->arrivalNs;  // Waiting starts at submission
+    process->deadlineNs = record->deadlineMs ? record->arrivalNs + record->deadlineMs * 1000000ull : 0;
+    process->stridePass = strideGlobalPass + stride_of(index);  // As if it had just run a slice
+    process->adoptedStartTicks = 0;
+    if (predicts_bursts()) {
+        // Executables never seen before are guessed to need one slice
+        int predicted = (int)(burst_history_predict(process->executableName, TSLICE) + 0.5);
+        process->predictedMs = predicted > 0 ? predicted : 1;
+        process->estimateMs = process->predictedMs;
+        job_remaining()[index] = process->predictedMs;
+    }
+
+    sharedData->readyQueue.submittedProcess++;
+    journal_submit(index, record, record->argBytes > 0 ? block : NULL);
+    return index;
+}
+
+static void pending_spawn(size_t index);
+static void refuse_gang(size_t leader);
+
+// Create a newly entered job's process now, stopped, so its first dispatch is
+// a plain resume; a gang is created and queued once its last stage is entered.
+// Per-CPU dispatch spawns after the drain instead, see spawn_pending(), and
+// has no gangs. A job that has already failed is left alone, but a gang is
+// still launched through it, so its other stages fail too.
+static void queue_job(size_t index, const SubmitRecord *record) {
+    if (record->gangSize <= 1 && job_states()[index] != JOB_QUEUED) return;
+    if (sharedData->dispatchMode == DISPATCH_PERCPU) {
+        if (record->gangSize <= 1) pending_spawn(index);
+        else if (record->gangStage == record->gangSize - 1) refuse_gang(job_info(index)->gangLeader);
+    } else if (record->gangSize <= 1) {
+        add_to_ready_queue(index);
+        launch_job(index);
+    } else if (record->gangStage == record->gangSize - 1) {
+        add_to_ready_queue(job_info(index)->gangLeader);
+        launch_gang(job_info(index)->gangLeader);
+    }
+}
+
+static void stats_submitted(void) {
+    LiveStats *stats = &sharedData->liveStats;
+    stats_begin(stats);
+    stats->submitted = sharedData->readyQueue.submittedProcess;
+    stats_end(stats);
+}
+
+// Jobs a previous scheduler left unfinished, read from its journal at startup
+// and entered on the first drain
+static JournalJob *recoveredJobs;
+static size_t recoveredCount;
+static bool recoveryPending;
+
+// Take a still running job of a crashed scheduler back: it is not our child,
+// so its exit is noticed by polling instead of wait4()
+static void adopt_job(size_t index, pid_t pid, uint64_t startTicks) {
+    job_pids()[index] = pid;
+    job_states()[index] = JOB_RUNNABLE;
+    job_info(index)->adoptedStartTicks = startTicks;
+    pid_index_insert(pid, index);
+    stop_job(index);  // Its scheduler may have died in the middle of its slice
+    journal_start(index, pid);
+    log_at(LOG_JOBS, "Re-adopted %s as PID %d\n", job_info(index)->executableName, pid);
+}
+
+// Enter the jobs recovered from the journal into the table, journaling them
+// afresh, then replace the old journal with the new one. Jobs that never
+// started are spawned again; jobs whose processes are still alive are
+// re-adopted where they stopped; jobs whose processes are gone exited while no
+// scheduler was watching and are completed as failed. A gang is spawned again
+// only if none of its stages had started.
+static void recover_jobs(void) {
+    uint64_t start = now_ns();
+    int requeued = 0, adopted = 0, gone = 0;
+
+    if (sharedData->jobCount + recoveredCount > sharedData->jobCapacity &&
+        grow_job_table(sharedData->jobCount + recoveredCount) == -1) {
+        fprintf(stderr, "Job table could not grow; recovered jobs dropped.\n");
+        recoveredCount = 0;
+    }
+    reserve_job_state();
+    for (size_t i = 0; i < recoveredCount; i++) {
+        JournalJob *job = &recoveredJobs[i];
+        SubmitRecord *record = &job->record;
+        if (record->arrivalNs > start) record->arrivalNs = start;  // Journaled before a reboot
+        size_t index = enter_job(record, job->block);
+
+        if (job->pid == 0 && !job->exited) {
+            // The strings move from the journal copy to the job, and are freed once it is spawned
+            if (record->argBytes > 0 && set_spawn_args(index, record, job->block) == -1) {
+                fail_launch(index);  // Not without its arguments
+            } else if (spawn_args(index) != NULL) {
+                spawn_args(index)->owned = true;
+                job->block = NULL;
+            }
+            requeued++;
+        } else if (!job->exited && job->startTicks != 0 && journal_process_start(job->pid) == job->startTicks) {
+            adopt_job(index, job->pid, job->startTicks);
+            adopted++;
+        } else {
+            if (!job->exited) gone++;
+            fail_launch(index);
+        }
+
+        if (record->gangSize <= 1) {
+            if (job_states()[index] == JOB_QUEUED) queue_job(index, record);
+            else if (job_states()[index] == JOB_RUNNABLE) add_to_ready_queue(index);
+            continue;
+        }
+        if (record->gangStage != record->gangSize - 1) continue;
+        size_t leader = job_info(index)->gangLeader;
+        bool anyStarted = false;
+        for (size_t stage = leader; stage <= index; stage++) {
+            anyStarted |= job_states()[stage] != JOB_QUEUED;
+        }
+        if (!anyStarted) {
+            queue_job(index, record);
+            continue;
+        }
+
+        // A gang with stages already running cannot have the others join its pipes
+        bool anyRunning = false;
+        for (size_t stage = leader; stage <= index; stage++) {
+            if (job_states()[stage] == JOB_QUEUED) fail_launch(stage);
+            anyRunning |= job_states()[stage] == JOB_RUNNABLE;
+        }
+        if (anyRunning && sharedData->dispatchMode == DISPATCH_PERCPU) refuse_gang(leader);
+        else if (anyRunning) add_to_ready_queue(leader);
+    }
+
+    journal_free_jobs(recoveredJobs, recoveredCount);
+    recoveredJobs = NULL;
+    recoveryPending = false;
+    journal_install();
+    stats_submitted();
+    if (requeued + adopted + gone > 0) {
+        log_at(LOG_SUMMARY, "Recovered %d jobs from the journal in %.2f ms: %d re-adopted, %d resubmitted, %d found exited.\n",
+               requeued + adopted + gone, (now_ns() - start) / 1e6, adopted, requeued, gone);
+    }
+    recoveredCount = 0;
+}
+
+// Move every published submission into the job table and ready queue in one batch,
+// growing the table when it fills. Records that cannot be placed stay in the ring.
+// The batch is journaled with a single commit.
+static void drain_submissions(void) {
+    INSTRUMENT_BEGIN(start);
+    journal_begin_batch();
+    if (recoveryPending) recover_jobs();
+
+    SubmitRing *ring = &sharedData->submitRing;
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    if (head != tail && sharedData->jobCount + (tail - head) > sharedData->jobCapacity) {
+        if (grow_job_table(sharedData->jobCount + (tail - head)) == -1) {
+            fprintf(stderr, "Job table could not grow; submissions left queued.\n");
+        }
+        ring = &sharedData->submitRing;  // The segment may have moved
+    }
+    reserve_job_state();
+
+    for (; head != tail && sharedData->jobCount < sharedData->jobCapacity; head++) {
+        const SubmitRecord *record = &ring->records[head & (SUBMIT_RING_SIZE - 1)];
+        const char *block = ring->arena + (record->argOffset & (SUBMIT_ARENA_SIZE - 1));
+        size_t index = enter_job(record, block);
+
+        // Its strings are read straight from the arena, or copied out if it must
+        // wait. A job whose strings cannot be kept fails rather than running without them.
+        if (record->argBytes > 0 && set_spawn_args(index, record, ring->arena) == -1) fail_launch(index);
+        queue_job(index, record);
+        if (record->argBytes > 0) {
+            if (job_states()[index] == JOB_QUEUED && own_spawn_args(index, record->argBytes) == -1) {
+                fail_launch(index);
+            }
+            atomic_store_explicit(&ring->arenaHead, record->argOffset + record->argBytes, memory_order_release);
+        }
+    }
+
+    // Hand the consumed records and arena space back to the shell
+    if (head != atomic_load_explicit(&ring->head, memory_order_relaxed)) stats_submitted();
+    atomic_store_explicit(&ring->head, head, memory_order_release);
+    journal_end_batch();
+    INSTRUMENT_END(start, currentSlot, PHASE_DRAIN);
+}
+
+
+
+static uint64_t timeval_ns(struct timeval tv) {
+    return (uint64_t)tv.tv_sec * 1000000000ull + (uint64_t)tv.tv_usec * 1000ull;
+}
+
+// Record that a job has terminated; status and usage are as reported by wait4
+static void complete_process(size_t index, int status, const struct rusage *usage) {
+    ProcessInfo *process = job_info(index);
+
+    if (WIFEXITED(status)) {
+        log_at(LOG_JOBS, "Process %s exited normally with status %d\n", process->executableName, WEXITSTATUS(status));
+    } else {
+        log_at(LOG_JOBS, "Process %s was terminated by signal %d\n", process->executableName, WTERMSIG(status));
+    }
+    job_states()[index] = JOB_DONE;
+    process->end_time = schedBackend->now(); // Set completion time
+    trace_event(TRACE_EXIT, index, process->end_time);
+    stats_job_done(index);
+    process->cpuUserNs = timeval_ns(usage->ru_utime);
+    process->cpuSysNs = timeval_ns(usage->ru_stime);
+    process->memoryPeakKb = usage->ru_maxrss;
+    completedProcesses++;
+    journal_exit(index);
+#ifdef SCHED_INSTRUMENT
+    if (perfEventsEnabled) perf_job_close(index);
+#endif
+
+    // An adopted job's usage is not known, so it says nothing about its bursts
+    if (predicts_bursts() && WIFEXITED(status) && process->adoptedStartTicks == 0) {
+        burst_history_update(process->executableName, (process->cpuUserNs + process->cpuSysNs) / 1e6);
+    }
+}
+
+// Complete a job that cannot be started as failed
+static void fail_launch(size_t index) {
+    job_states()[index] = JOB_DONE;
+    job_info(index)->end_time = now_ns();
+    completedProcesses++;
+    stats_job_done(index);
+    journal_exit(index);
+#ifdef SCHED_INSTRUMENT
+    if (perfEventsEnabled) perf_job_close(index);
+#endif
+}
+
+// Open the files a job's standard streams are redirected to, -1 for an
+// inherited stream. Returns -1 after closing what was opened if one fails.
+static int open_redirects(size_t index, const SpawnArgs *spawn, const char *files, int fds[3]) {
+    static const char *streamNames[3] = { "stdin", "stdout", "stderr" };
+
+    for (int stream = 0; stream < 3; stream++) {
+        int flags = stream == 0 ? O_RDONLY : O_WRONLY | O_CREAT | (spawn->appendStreams & (1 << stream) ? O_APPEND : O_TRUNC);
+        fds[stream] = -1;
+        if (files[0] != '\0') {
+            fds[stream] = open(files, flags | O_CLOEXEC, 0644);
+            if (fds[stream] == -1) {
+                fprintf(stderr, "Cannot open %s of %s: %s: %s\n", streamNames[stream],
+                        job_info(index)->executableName, files, strerror(errno));
+                while (--stream >= 0) {
+                    if (fds[stream] != -1) close(fds[stream]);
+                }
+                return -1;
+            }
+        }
+        files += strlen(files) + 1;
+    }
+    return 0;
+}
+
+// The environment of a job: ours, with the job's NAME=value strings replacing
+// or adding to it
+static char **job_environment(const SpawnArgs *spawn, char **overrides) {
+    size_t count = 0;
+    while (environ[count] != NULL) count++;
+    char **env = malloc((count + spawn->envc + 1) * sizeof(char *));
+    if (env == NULL) return NULL;
+
+    size_t length = 0;
+    for (size_t i = 0; i < count; i++) {
+        size_t nameLength = strcspn(environ[i], "=");
+        int overridden = 0;
+        for (int j = 0; j < spawn->envc && !overridden; j++) {
+            overridden = strncmp(overrides[j], environ[i], nameLength) == 0 && overrides[j][nameLength] == '=';
+        }
+        if (!overridden) env[length++] = environ[i];
+    }
+    for (int j = 0; j < spawn->envc; j++) env[length++] = overrides[j];
+    env[length] = NULL;
+    return env;
+}
+
+// Spawn a job that has not started yet and leave it stopped, so its first slice
+// starts when a dispatcher sends SIGCONT. Returns -1 if no process was created;
+// the job stays queued when the failure is transient (EAGAIN, ENOMEM) and is
+// completed as failed otherwise.
+//
+// The child is created with vfork, so nothing of the scheduler's address space
+// is copied, and execs the path the shell resolved at submit time. It asks to
+// be traced first, which makes the kernel stop it at its first instruction
+// after exec; detaching with SIGSTOP then leaves it in an ordinary stop. Where
+// tracing is not permitted the job is stopped with SIGSTOP right after exec.
+//
+// A job submitted with arguments gets them as its argv, its environment
+// overrides on top of ours, and its redirected streams opened here so that its
+// output goes straight to the files without passing through the scheduler.
+static int launch_process(size_t index) {
+    ProcessInfo *process = job_info(index);
+    const SpawnArgs *spawn = spawn_args(index);
+    char *plainArgs[2] = { process->executableName, NULL };
+    // Live across vfork(), so kept in memory rather than registers the child could clobber
+    char **volatile args = plainArgs;
+    char **volatile env = environ;
+    int fds[3] = { -1, -1, -1 };
+    const char *volatile path = process->executablePath;
+    volatile int traced = 0;
+    volatile int execError = 0;
+    sigset_t allSignals, noSignals, oldMask;
+
+    if (spawn != NULL) {
+        // Unpack the block: argv, then the environment, then the three redirections
+        char **strings = malloc((spawn->argc + 1 + spawn->envc) * sizeof(char *));
+        char *next = (char *)spawn->block;
+        if (strings == NULL) {
+            perror("malloc");
+            return -1;  // Transient; the job stays queued
+        }
+        for (int i = 0; i < spawn->argc + spawn->envc; i++) {
+            strings[i < spawn->argc ? i : i + 1] = next;
+            next += strlen(next) + 1;
+        }
+        strings[spawn->argc] = NULL;
+        args = strings;
+        env = job_environment(spawn, strings + spawn->argc + 1);
+        if (env == NULL || open_redirects(index, spawn, next, fds) == -1) {
+            if (env == NULL) perror("malloc");
+            else fail_launch(index);
+            free(env);
+            free(strings);
+            return -1;
+        }
+    }
+
+    // No handler may run in the child while it still shares our memory
+    sigfillset(&allSignals);
+    sigemptyset(&noSignals);
+    sigprocmask(SIG_BLOCK, &allSignals, &oldMask);
+
+    uint64_t spawnStart = now_ns();
+    pid_t pid = vfork();
+    if (pid == 0) {  // Child process, running on the scheduler's memory until exec
+        traced = ptrace(PTRACE_TRACEME, 0, NULL, NULL) == 0;
+        // A stopped job whose process group is orphaned by the scheduler dying is
+        // sent SIGHUP; in a session of its own it survives to be re-adopted
+        if (journalPath != NULL) setsid();
+        signal(SIGINT, SIG_DFL);
+        sigprocmask(SIG_SETMASK, &noSignals, NULL);
+        for (int stream = 0; stream < 3; stream++) {
+            // A redirection wins over a gang stage's pipe, as in a shell
+            int fd = fds[stream] != -1 ? fds[stream] : stream < 2 ? stagePipe[stream] : -1;
+            // dup2 clears close-on-exec on the copy; a file already on its stream keeps it
+            if (fd == stream) fcntl(stream, F_SETFD, 0);
+            else if (fd != -1) dup2(fd, stream);
+        }
+        execve(path, args, env);
+        execError = errno;
+        _exit(127);
+    }
+    int err = pid < 0 ? errno : execError;
+    sigprocmask(SIG_SETMASK, &oldMask, NULL);
+    for (int stream = 0; stream < 3; stream++) {
+        if (fds[stream] != -1) close(fds[stream]);
+    }
+    if (env != environ) free(env);
+    if (args != plainArgs) free(args);
+
+    int status;
+    struct rusage usage;
+    if (pid > 0 && err != 0) {
+        wait4(pid, &status, 0, &usage);  // Reap the child whose exec failed
+    }
+    if (err != 0) {
+        fprintf(stderr, "Spawn failed for %s: %s\n", process->executableName, strerror(err));
+        if (err != EAGAIN && err != ENOMEM) fail_launch(index);
+        return -1;
+    }
+
+    pid_t result;
+    if (traced) {
+        result = wait4(pid, &status, 0, &usage);  // The post-exec SIGTRAP stop
+        if (result == pid && WIFSTOPPED(status)) {
+            ptrace(PTRACE_DETACH, pid, NULL, (void *)(long)SIGSTOP);
+            result = wait4(pid, &status, WUNTRACED, &usage);
+        }
+    } else {
+        kill(pid, SIGSTOP);
+        result = wait4(pid, &status, WUNTRACED, &usage);
+    }
+    process->spawnNs = now_ns() - spawnStart;
+
+    job_pids()[index] = pid;
+    job_states()[index] = JOB_RUNNABLE;
+    pid_index_insert(pid, index);
+    log_at(LOG_JOBS, "Spawned %s as PID %d in %.3f ms\n", process->executableName, pid, process->spawnNs / 1e6);
+
+    if (result == pid && !WIFSTOPPED(status)) {
+        complete_process(index, status, &usage);  // Finished before the stop landed
+    }
+    return 0;
+}
+
+// Check whether a job that was running has exited, completing it if so.
+// Returns 1 if the job has terminated.
+static int reap_if_exited(size_t index) {
+    int status;
+    struct rusage usage;
+
+    if (job_states()[index] != JOB_RUNNABLE) return 1;  // Already reaped by handle_child_termination
+    INSTRUMENT_BEGIN(start);
+    int exited = schedBackend->reap(index, &status, &usage);
+    INSTRUMENT_END(start, job_last_slots()[index], PHASE_REAP);
+    if (!exited) return 0;
+    complete_process(index, status, &usage);
+    return 1;
+}
+
+// After a slice, check whether the job exited and re-queue it otherwise.
+// Returns 1 if the job has terminated.
+// A gang stage is left for requeue_gangs(), which re-queues its gang once.
+static int finish_slice(size_t index, int sliceMs) {
+    if (reap_if_exited(index)) return 1;
+
+    // The process is still running; re-queue it
+    if (in_gang(index)) {
+        note_preempted(index);
+    } else {
+        requeue_process(index, sliceMs);
+    }
+    return 0;
+}
+
+// Dispatch overhead: the dispatch loops' own wall time, excluding the time
+// they hand to jobs in backend waits and sleeps. Always the real clock, so
+// the simulator reports its real cost too. Each per-CPU dispatcher keeps its own.
+static _Thread_local uint64_t dispatchSince;
+#ifdef SCHED_INSTRUMENT
+static _Thread_local uint64_t waitSince;  // When the dispatch clock last stopped, 0 before it first has
+#endif
+
+static void dispatch_clock_start(void) {
+    dispatchSince = now_ns();
+#ifdef SCHED_INSTRUMENT
+    if (waitSince != 0) instrument_record(currentSlot, PHASE_WAIT, dispatchSince - waitSince);
+    waitSince = 0;
+#endif
+}
+
+static void dispatch_clock_stop(void) {
+    uint64_t now = now_ns();
+    sharedData->dispatchNs += now - dispatchSince;
+#ifdef SCHED_INSTRUMENT
+    waitSince = now;
+#endif
+}
+
+// Every submitted job has finished and no more are due
+static int all_jobs_done(uint64_t nextArrival) {
+    return completedProcesses >= sharedData->readyQueue.submittedProcess && nextArrival == UINT64_MAX;
+}
+
+// Continuous mode: block until the shell publishes a submission or a stop
+// request, or timeoutMs passes (-1 for no limit). Returns 0 without waiting
+// when the scheduler should return instead: it is not in continuous mode or
+// the shell has asked it to stop.
+static int wait_for_work(int timeoutMs) {
+    if (schedulerWakeFd == -1 || atomic_load(&sharedData->stopRequested)) return 0;
+
+    struct pollfd wake = { .fd = schedulerWakeFd, .events = POLLIN };
+    dispatch_clock_stop();
+    if (poll(&wake, 1, timeoutMs) > 0) {
+        uint64_t count;
+        read(schedulerWakeFd, &count, sizeof(count));
+    }
+    dispatch_clock_start();
+    return 1;
+}
+
+// Account the time a job spent waiting up to a resume at time now
+static void note_resumed(size_t index, uint64_t now) {
+    ProcessInfo *process = job_info(index);
+    trace_event(TRACE_RESUME, index, now);
+    stats_slot_start(index, now);
+    sharedData->slicesStarted++;
+    process->slices++;
+    if (process->start_time == 0) {
+        process->start_time = now;
+    }
+    process->wait_time += now - process->lastPausedTime;
+}
+
+// Resume every job in the batch, let them share one time slice, then stop and reap them
+static void run_slice(const size_t *batch, int count) {
+
+    // A batch shares one sleep, so it runs for the shortest quantum among its jobs
+    int sliceMs = slice_for(policy_job(batch[0]));
+    for (int i = 1; i < count; i++) {
+        int jobSlice = slice_for(policy_job(batch[i]));
+        if (jobSlice < sliceMs) sliceMs = jobSlice;
+    }
+
+    uint64_t start = schedBackend->now();
+    for (int i = 0; i < count; i++) {
+        resume_job(batch[i]);
+        note_resumed(batch[i], start);
+        job_info(batch[i])->sliceMs = sliceMs;
+    }
+
+    // Let the batch run for the specified time slice
+    dispatch_clock_stop();
+    schedBackend->sleep_until(start + (uint64_t)sliceMs * 1000000ull);
+    dispatch_clock_start();
+
+    // After the time slice, pause every process that is still running
+    uint64_t end = schedBackend->now();
+    for (int i = 0; i < count; i++) {
+        stop_job(batch[i]);
+        job_info(batch[i])->lastPausedTime = end;
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (!finish_slice(batch[i], sliceMs)) adapt_slice(batch[i], end - start);
+    }
+    requeue_gangs(batch, count);
+}
+
+// Process backend: real children stopped and resumed with signals. Event-driven
+// dispatch waits on an epoll set holding a timerfd for the next slice deadline
+// and a pidfd per running job, or a SIGCHLD signalfd on kernels without pidfd_open.
+
+#define TIMER_EVENT ((uint64_t)-1)
+#define SIGCHLD_EVENT ((uint64_t)-2)
+#define WAKE_EVENT ((uint64_t)-3)
+
+static int epfd = -1;
+static int timerfd = -1;
+static int sigfd = -1;
+static int usePidfd = 1;
+static sigset_t oldMask;
+static int slotPidfd[MAX_NCPU];
+
+static int pidfd_open(pid_t pid) {
+    return (int)syscall(SYS_pidfd_open, pid, 0);
+}
+
+static void process_resume(size_t index) {
+    kill(job_pids()[index], SIGCONT);  // Send SIGCONT to the child process
+}
+
+static void process_stop(size_t index) {
+    kill(job_pids()[index], SIGSTOP);  // Send SIGSTOP to the child process
+}
+
+static int process_reap(size_t index, int *status, struct rusage *usage) {
+    // A job re-adopted from a crashed scheduler is not our child and cannot be
+    // waited for; it has exited once its pid is gone or names another process
+    uint64_t adoptedStartTicks = job_info(index)->adoptedStartTicks;
+    if (adoptedStartTicks != 0) {
+        if (journal_process_start(job_pids()[index]) == adoptedStartTicks) return 0;
+        log_at(LOG_JOBS, "Adopted process %s has exited; its status is unknown.\n", job_info(index)->executableName);
+        *status = 0;
+        memset(usage, 0, sizeof(*usage));
+        return 1;
+    }
+
+    pid_t result = wait4(job_pids()[index], status, WNOHANG, usage);
+    if (result == -1) {
+        perror("waitpid failed");
+    }
+    return result > 0;
+}
+
+// The first field of /proc/<pid>/schedstat is the time the task has spent on a CPU, in ns
+static uint64_t process_cpu_time(size_t index) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/schedstat", job_pids()[index]);
+    FILE *file = fopen(path, "r");
+    if (file == NULL) return UINT64_MAX;
+
+    unsigned long long runNs;
+    int fields = fscanf(file, "%llu", &runNs);
+    fclose(file);
+    return fields == 1 ? runNs : UINT64_MAX;
+}
+
+static void process_sleep_until(uint64_t deadline) {
+    struct timespec ts;
+    ts.tv_sec = deadline / 1000000000ull;
+    ts.tv_nsec = deadline % 1000000000ull;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+    }
+}
+
+// Every submission is already in the ring when the scheduler starts
+static uint64_t process_next_arrival(void) {
+    return UINT64_MAX;
+}
+
+static void process_open_events(void) {
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (epfd == -1 || timerfd == -1) {
+        perror("epoll/timerfd setup failed");
+        exit(EXIT_FAILURE);
+    }
+    struct epoll_event ev = { .events = EPOLLIN, .data.u64 = TIMER_EVENT };
+    epoll_ctl(epfd, EPOLL_CTL_ADD, timerfd, &ev);
+
+    // In continuous mode a submission ends the wait, so it can take an idle slot at once
+    if (schedulerWakeFd != -1) {
+        ev.data.u64 = WAKE_EVENT;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, schedulerWakeFd, &ev);
+    }
+    for (int i = 0; i < MAX_NCPU; i++) {
+        slotPidfd[i] = -1;
+    }
+
+    // Kernels without pidfd_open (< 5.3) get completion events from a SIGCHLD signalfd
+    usePidfd = 1;
+    int probe = pidfd_open(getpid());
+    if (probe == -1 && errno == ENOSYS) {
+        sigset_t chldMask;
+        usePidfd = 0;
+        sigemptyset(&chldMask);
+        sigaddset(&chldMask, SIGCHLD);
+        sigprocmask(SIG_BLOCK, &chldMask, &oldMask);
+        sigfd = signalfd(-1, &chldMask, SFD_CLOEXEC);
+        ev.data.u64 = SIGCHLD_EVENT;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, sigfd, &ev);
+        log_at(LOG_SUMMARY, "pidfd_open unavailable, using SIGCHLD signalfd.\n");
+    } else if (probe >= 0) {
+        close(probe);
+    }
+}
+
+static void process_watch(int slot, size_t index) {
+    if (!usePidfd) return;
+    slotPidfd[slot] = pidfd_open(job_pids()[index]);
+    if (slotPidfd[slot] == -1) {
+        perror("pidfd_open");
+    } else {
+        struct epoll_event ev = { .events = EPOLLIN, .data.u64 = (uint64_t)slot };
+        epoll_ctl(epfd, EPOLL_CTL_ADD, slotPidfd[slot], &ev);
+    }
+}
+
+static void process_unwatch(int slot) {
+    if (slotPidfd[slot] >= 0) {
+        epoll_ctl(epfd, EPOLL_CTL_DEL, slotPidfd[slot], NULL);
+        close(slotPidfd[slot]);
+        slotPidfd[slot] = -1;
+    }
+}
+
+// Sleep until the deadline or a job exit. Exited jobs are reaped by the caller,
+// except under the SIGCHLD fallback, where handle_child_termination reaps them.
+static void process_wait_event(uint64_t deadline) {
+    struct epoll_event events[MAX_NCPU + 2];
+    struct itimerspec its = {0};
+    its.it_value.tv_sec = deadline / 1000000000ull;
+    its.it_value.tv_nsec = deadline % 1000000000ull;
+    timerfd_settime(timerfd, TFD_TIMER_ABSTIME, &its, NULL);
+
+    int n = epoll_wait(epfd, events, MAX_NCPU + 2, -1);
+    if (n == -1 && errno != EINTR) {
+        perror("epoll_wait failed");
+    }
+    for (int e = 0; e < n; e++) {
+        if (events[e].data.u64 == TIMER_EVENT) {
+            uint64_t expirations;
+            read(timerfd, &expirations, sizeof(expirations));
+        } else if (events[e].data.u64 == WAKE_EVENT) {
+            uint64_t count;
+            read(schedulerWakeFd, &count, sizeof(count));
+        } else if (events[e].data.u64 == SIGCHLD_EVENT) {
+            struct signalfd_siginfo info;
+            read(sigfd, &info, sizeof(info));
+            handle_child_termination(SIGCHLD);
+        }
+    }
+}
+
+static void process_close_events(void) {
+    close(timerfd);
+    close(epfd);
+    if (sigfd != -1) {
+        close(sigfd);
+        sigfd = -1;
+        sigprocmask(SIG_SETMASK, &oldMask, NULL);
+    }
+}
+
+const SchedBackend processBackend = {
+    .now = now_ns,
+    .next_arrival = process_next_arrival,
+    .launch = launch_process,
+    .resume = process_resume,
+    .stop = process_stop,
+    .reap = process_reap,
+    .cpu_time = process_cpu_time,
+    .sleep_until = process_sleep_until,
+    .open_events = process_open_events,
+    .watch = process_watch,
+    .unwatch = process_unwatch,
+    .wait_event = process_wait_event,
+    .close_events = process_close_events,
+};
+
+const SchedBackend *schedBackend = &processBackend;
+
+// One simulated CPU in the event-driven loop
+typedef struct {
+    size_t index;             // Job occupying the slot, or (size_t)-1 when idle
+    uint64_t deadline;        // Time at which the slice ends, in ns
+    int sliceMs;              // Length of the current slice
+    uint64_t freedDeadline;   // Deadline of a job that exited early, until the slot is refilled
+} CpuSlot;
+
+// Free a slot whose job has either exited or been stopped
+static void release_slot(CpuSlot *slots, int slotId) {
+    schedBackend->unwatch(slotId);
+    slots[slotId].index = (size_t)-1;
+}
+
+// Jobs next_ready_job() has passed over in its current scan
+static uint32_t *deferredJobs;
+static size_t deferredCapacity;
+
+// Take the next ready job, spawning it if that failed transiently at submission; returns (size_t)-1 when none is runnable.
+// A job whose spawn fails again, or is still backing off, is set aside and put
+// back on the ready queue once the scan is over, so the jobs behind it still run.
+static size_t next_ready_job(void) {
+    uint64_t now = schedBackend->now();
+    size_t deferred = 0;
+    size_t found = (size_t)-1;
+    while (found == (size_t)-1) {
+        size_t index = get_from_ready_queue();
+        if (index == (size_t)-1) break;
+
+        if (index >= sharedData->jobCount) {
+            fprintf(stderr, "Invalid index: %zu\n", index);
+            continue;
+        }
+
+        if (job_states()[index] == JOB_QUEUED && (!spawn_due(index, now) || launch_job(index) == -1)) {
+            if (job_states()[index] != JOB_QUEUED) continue;  // Failed for good
+            if (deferred == deferredCapacity) {
+                size_t capacity = deferredCapacity ? deferredCapacity * 2 : 64;
+                uint32_t *grown = realloc(deferredJobs, capacity * sizeof(uint32_t));
+                if (grown == NULL) {
+                    perror("realloc");
+                    add_to_ready_queue(index);  // Retry on a later pass, and look no further now
+                    break;
+                }
+                deferredJobs = grown;
+                deferredCapacity = capacity;
+            }
+            deferredJobs[deferred++] = (uint32_t)index;
+            continue;
+        }
+        if (job_states()[index] == JOB_RUNNABLE) {  // Process is already created and assigned a PID
+            found = index;
+            continue;
+        }
+        size_t stages[NCPU];
+        if (in_gang(index) && gang_stages(index, stages) > 0) {  // A gang whose first stage has exited
+            found = index;
+        }
+    }
+    for (size_t i = 0; i < deferred; i++) add_to_ready_queue(deferredJobs[i]);
+    return found;
+}
+
+static size_t heldGang = (size_t)-1;  // A gang waiting for enough free slots
+
+// Take the next ready job, or all running stages of the next ready gang, for
+// at most room free slots, writing them to jobs; returns how many, 0 if none.
+// A gang that does not fit is held, and nothing is taken past it, until it does.
+static int next_ready_unit(size_t *jobs, int room) {
+    size_t index = heldGang != (size_t)-1 ? heldGang : next_ready_job();
+    heldGang = (size_t)-1;
+    if (index == (size_t)-1) return 0;
+
+    if (!in_gang(index)) {
+        jobs[0] = index;
+        return 1;
+    }
+    int count = gang_stages(index, jobs);
+    if (count > room) {
+        heldGang = index;
+        return 0;
+    }
+    return count;
+}
+
+// Soft affinity: reuse the slot a job last ran on when it is free, otherwise the first free slot
+static int pick_slot(size_t index, const bool *slotFree) {
+    int last = job_last_slots()[index];
+    if (last >= 0 && last < NCPU && slotFree[last]) return last;
+    for (int i = 0; i < NCPU; i++) {
+        if (slotFree[i]) return i;
+    }
+    return -1;
+}
+
+// Record the slot a job is about to run on, pinning it to that slot's core when it moves
+static void bind_to_slot(size_t index, int slot) {
+    int16_t *lastSlot = &job_last_slots()[index];
+
+    if (*lastSlot == slot) {
+        job_info(index)->warmResumes++;
+        return;
+    }
+    if (*lastSlot != -1) {
+        job_info(index)->migrations++;
+    }
+    *lastSlot = (int16_t)slot;
+
+    if (sharedData->affinityEnabled) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(sharedData->slotCore[slot], &set);
+        if (sched_setaffinity(job_pids()[index], sizeof(set), &set) == -1) {
+            perror("sched_setaffinity");
+        }
+    }
+}
+
+// Resume a job on an idle slot and start that slot's slice of sliceMs at time now
+static void start_on_slot(CpuSlot *slots, int slotId, size_t index, uint64_t now, int sliceMs) {
+    CpuSlot *slot = &slots[slotId];
+
+    schedBackend->watch(slotId, index);
+    bind_to_slot(index, slotId);
+    resume_job(index);
+    note_resumed(index, now);
+
+    // Time this slot would have sat idle under fixed slices
+    if (slot->freedDeadline > now) {
+        sharedData->idleTimeSavedNs += slot->freedDeadline - now;
+    }
+    slot->freedDeadline = 0;
+    slot->index = index;
+    slot->sliceMs = sliceMs;
+    slot->deadline = now + (uint64_t)sliceMs * 1000000ull;
+    job_info(index)->sliceMs = sliceMs;
+}
+
+// Start a job, or every stage of a gang with one shared deadline, on free slots
+static void start_unit(CpuSlot *slots, bool *slotFree, const size_t *jobs, int count) {
+    int sliceMs = slice_for(policy_job(jobs[0]));
+    uint64_t now = schedBackend->now();
+    for (int i = 0; i < count; i++) {
+        int slot = pick_slot(jobs[i], slotFree);
+        start_on_slot(slots, slot, jobs[i], now, sliceMs);
+        slotFree[slot] = false;
+    }
+}
+
+// Heap key a running job would have now: under SRTF its predicted time left
+// less what it has run of this slice, under EDF its deadline
+static uint64_t running_key(const CpuSlot *slot, uint64_t now, int *ranMs) {
+    *ranMs = (int)((now - (slot->deadline - (uint64_t)slot->sliceMs * 1000000ull)) / 1000000);
+    if (sharedData->policy == POLICY_EDF) return job_keys()[slot->index];
+    int64_t left = (int64_t)job_remaining()[slot->index] - *ranMs;
+    return left > 0 ? (uint64_t)left : 0;
+}
+
+// Preemption for heap-ordered policies: while the first ready job's key is
+// below some running job's (it is predicted to finish sooner under SRTF, or
+// is due sooner under EDF), stop the running job with the largest key and
+// give its slot to the ready one. Gangs neither preempt nor are preempted,
+// as that would split their stages.
+static void preempt_longer_jobs(CpuSlot *slots, uint64_t now) {
+    while (sharedData->readyQueue.heapCount > 0 && heldGang == (size_t)-1 && !in_gang(ready_heap()[0])) {
+        int victim = -1;
+        int ranMs = 0;
+        uint64_t victimKey = 0;
+        for (int i = 0; i < NCPU; i++) {
+            if (slots[i].index == (size_t)-1) return;  // An idle slot means nothing is waiting for one
+            if (in_gang(slots[i].index)) continue;
+            int slotRanMs;
+            uint64_t key = running_key(&slots[i], now, &slotRanMs);
+            if (victim == -1 || key > victimKey) {
+                victim = i;
+                victimKey = key;
+                ranMs = slotRanMs;
+            }
+        }
+        if (victim == -1 || job_keys()[ready_heap()[0]] >= victimKey) return;
+
+        size_t index = slots[victim].index;
+        log_at(LOG_JOBS, "Preempting %s for a %s job.\n", job_info(index)->executableName,
+               sharedData->policy == POLICY_EDF ? "more urgent" : "shorter");
+        stop_job(index);
+        job_info(index)->lastPausedTime = now;
+        finish_slice(index, ranMs);
+        release_slot(slots, victim);
+
+        size_t next[NCPU];
+        if (next_ready_unit(next, 1) == 0) return;
+        start_on_slot(slots, victim, next[0], schedBackend->now(), slice_for(policy_job(next[0])));
+    }
+}
+
+// Event-driven dispatch: every slot runs its own slice, and a job that exits early
+// is noticed right away so the slot can be refilled
+static void run_event_loop(void) {
+    schedBackend->open_events();
+
+    CpuSlot slots[NCPU];
+    for (int i = 0; i < NCPU; i++) {
+        slots[i].index = (size_t)-1;
+        slots[i].freedDeadline = 0;
+    }
+    uint64_t lastBoost = schedBackend->now();
+
+    for (;;) {
+        drain_submissions();
+        uint64_t nextArrival = schedBackend->next_arrival();
+        if (all_jobs_done(nextArrival)) {
+            if (wait_for_work(-1)) continue;
+            break;
+        }
+        maybe_boost(schedBackend->now(), &lastBoost);
+
+        // Put a ready job on every idle slot
+        bool slotFree[NCPU];
+        int idle = 0;
+        for (int i = 0; i < NCPU; i++) {
+            slotFree[i] = slots[i].index == (size_t)-1;
+            idle += slotFree[i];
+        }
+        while (idle > 0) {
+            size_t unit[NCPU];
+            INSTRUMENT_BEGIN(pickStart);
+            int count = next_ready_unit(unit, idle);
+            INSTRUMENT_END(pickStart, currentSlot, PHASE_PICK);
+            if (count == 0) break;
+            start_unit(slots, slotFree, unit, count);
+            idle -= count;
+        }
+        if (preempts_on_key()) {
+            preempt_longer_jobs(slots, schedBackend->now());
+        }
+
+        int busy = 0;
+        uint64_t nextDeadline = nextArrival;
+        for (int i = 0; i < NCPU; i++) {
+            if (slots[i].index == (size_t)-1) continue;
+            busy++;
+            if (slots[i].deadline < nextDeadline) nextDeadline = slots[i].deadline;
+        }
+
+        if (busy == 0 && nextArrival == UINT64_MAX) {
+            if (wait_for_work(TSLICE)) continue;  // Retry spawns that failed for now
+            log_at(LOG_SUMMARY, "No processes could be scheduled in this cycle.\n");
+            break;
+        }
+
+        dispatch_clock_stop();
+        schedBackend->wait_event(nextDeadline);
+        dispatch_clock_start();
+
+        // Free the slots of jobs that exited during the wait
+        uint64_t now = schedBackend->now();
+        for (int i = 0; i < NCPU; i++) {
+            if (slots[i].index != (size_t)-1 && reap_if_exited(slots[i].index)) {
+                slots[i].freedDeadline = slots[i].deadline > now ? slots[i].deadline : 0;
+                release_slot(slots, i);
+            }
+        }
+
+        // Preempt every slot whose slice has run out; a gang's stages share a deadline
+        size_t stopped[NCPU];
+        int stoppedCount = 0;
+        for (int i = 0; i < NCPU; i++) {
+            if (slots[i].index == (size_t)-1 || slots[i].deadline > now) continue;
+
+            stop_job(slots[i].index);
+            job_info(slots[i].index)->lastPausedTime = now;
+            if (!finish_slice(slots[i].index, slots[i].sliceMs)) {
+                adapt_slice(slots[i].index, now - (slots[i].deadline - (uint64_t)slots[i].sliceMs * 1000000ull));
+            }
+            stopped[stoppedCount++] = slots[i].index;
+            release_slot(slots, i);
+        }
+        requeue_gangs(stopped, stoppedCount);
+    }
+
+    schedBackend->close_events();
+}
+
+// Assign a round's jobs to slots, letting each keep its previous slot where possible.
+// Reorders batch so that batch[i] runs on the i-th occupied slot.
+static int place_batch(size_t *batch, int count) {
+    bool slotFree[NCPU];
+    size_t placedJob[NCPU];
+    for (int i = 0; i < NCPU; i++) {
+        slotFree[i] = true;
+    }
+
+    // Jobs whose previous slot is free claim it first so they cannot be displaced
+    for (int i = 0; i < count; i++) {
+        int last = job_last_slots()[batch[i]];
+        if (last >= 0 && last < NCPU && slotFree[last]) {
+            slotFree[last] = false;
+            placedJob[last] = batch[i];
+            batch[i] = (size_t)-1;
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        if (batch[i] == (size_t)-1) continue;
+        int slot = pick_slot(batch[i], slotFree);
+        slotFree[slot] = false;
+        placedJob[slot] = batch[i];
+    }
+
+    int placed = 0;
+    for (int i = 0; i < NCPU; i++) {
+        if (slotFree[i]) continue;
+        bind_to_slot(placedJob[i], i);
+        batch[placed++] = placedJob[i];
+    }
+    return placed;
+}
+
+// Per-CPU dispatch: a dispatcher thread per slot, each with its own run queue.
+// A dispatcher runs the jobs on its queue in turn, and a job it preempts goes
+// back on the same queue, so the job keeps its slot and the dispatchers never
+// share a queue. A dispatcher whose queue is empty steals half the queue of
+// the busiest peer. The main thread only drains submissions, spawns the new
+// jobs and spreads them over the least-loaded queues. Queues are FIFO, so this
+// is round robin per slot; priorities and the other policies need the global
+// queue, and the shell rejects them with this mode. Pipelines are refused too,
+// as a dispatcher runs one job at a time.
+//
+// The dispatchers touch the shared segment only under tableLock held shared.
+// The main thread holds it exclusively only while it drains submissions, as
+// growing the job table may move the segment, and spawns with it shared.
+
+#define STEAL_BATCH 32        // Most jobs taken from a peer in one steal
+
+typedef struct {
+    alignas(64) pthread_mutex_t lock;
+    uint32_t *jobs;           // Ring of job indices
+    uint32_t capacity;
+    uint32_t head;
+    _Atomic uint32_t count;   // Also read without the lock, to pick where to push and steal
+    int slot;
+    pthread_t thread;
+} RunQueue;
+
+static RunQueue *runQueues;
+static pthread_rwlock_t tableLock;
+static pthread_mutex_t idleLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t idleCond = PTHREAD_COND_INITIALIZER;  // Signalled when jobs are pushed by the main thread
+static _Atomic bool dispatchersRunning;
+static _Atomic int idleDispatchers;
+
+// Append jobs to a run queue; the caller holds its lock
+static void run_queue_append(RunQueue *queue, const uint32_t *jobs, uint32_t count) {
+    if (queue->count + count > queue->capacity) {
+        uint32_t capacity = queue->capacity ? queue->capacity : 64;
+        while (capacity < queue->count + count) capacity *= 2;
+        uint32_t *grown = malloc(capacity * sizeof(uint32_t));
+        if (grown == NULL) {
+            perror("malloc");
+            exit(EXIT_FAILURE);  // A dropped job would never finish
+        }
+        for (uint32_t i = 0; i < queue->count; i++) {
+            grown[i] = queue->jobs[(queue->head + i) % queue->capacity];
+        }
+        free(queue->jobs);
+        queue->jobs = grown;
+        queue->capacity = capacity;
+        queue->head = 0;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        queue->jobs[(queue->head + queue->count + i) % queue->capacity] = jobs[i];
+    }
+    atomic_fetch_add(&queue->count, count);
+    atomic_fetch_add(&percpuQueued, (int)count);
+}
+
+// Queue a job: on the dispatcher's own queue when a dispatcher re-queues it,
+// otherwise on the shortest queue. Idle dispatchers are woken for jobs from
+// the main thread, and for a queue that holds more than the job it re-queued.
+static void percpu_push(size_t index) {
+    int slot = currentSlot;
+    if (slot == -1) {
+        slot = 0;
+        for (int i = 1; i < NCPU; i++) {
+            if (runQueues[i].count < runQueues[slot].count) slot = i;
+        }
+    }
+    uint32_t job = (uint32_t)index;
+    pthread_mutex_lock(&runQueues[slot].lock);
+    run_queue_append(&runQueues[slot], &job, 1);
+    pthread_mutex_unlock(&runQueues[slot].lock);
+
+    if (currentSlot == -1 || (idleDispatchers > 0 && runQueues[slot].count > 1)) {
+        pthread_mutex_lock(&idleLock);
+        pthread_cond_broadcast(&idleCond);
+        pthread_mutex_unlock(&idleLock);
+    }
+}
+
+static size_t run_queue_pop(RunQueue *queue) {
+    size_t index = (size_t)-1;
+    pthread_mutex_lock(&queue->lock);
+    if (queue->count > 0) {
+        index = queue->jobs[queue->head];
+        queue->head = (queue->head + 1) % queue->capacity;
+        atomic_fetch_sub(&queue->count, 1);
+        atomic_fetch_sub(&percpuQueued, 1);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return index;
+}
+
+// Move up to half of the busiest peer's queue, from its far end, onto ours.
+// Returns 0 if every peer's queue is empty.
+static int steal_jobs(RunQueue *own) {
+    RunQueue *victim = NULL;
+    for (int i = 0; i < NCPU; i++) {
+        if (&runQueues[i] != own && runQueues[i].count > 0 && (victim == NULL || runQueues[i].count > victim->count)) {
+            victim = &runQueues[i];
+        }
+    }
+    if (victim == NULL) return 0;
+
+    uint32_t stolen[STEAL_BATCH];
+    uint32_t count;
+    pthread_mutex_lock(&victim->lock);
+    count = (victim->count + 1) / 2;
+    if (count > STEAL_BATCH) count = STEAL_BATCH;
+    for (uint32_t i = 0; i < count; i++) {
+        stolen[i] = victim->jobs[(victim->head + victim->count - count + i) % victim->capacity];
+    }
+    atomic_fetch_sub(&victim->count, count);
+    atomic_fetch_sub(&percpuQueued, (int)count);
+    pthread_mutex_unlock(&victim->lock);
+
+    pthread_mutex_lock(&own->lock);
+    run_queue_append(own, stolen, count);
+    pthread_mutex_unlock(&own->lock);
+    return count > 0;
+}
+
+// Take the next job to run, stealing when the queue is empty; returns
+// (size_t)-1 if there is none. Every queued job has been spawned already.
+static size_t percpu_take(RunQueue *own) {
+    for (;;) {
+        size_t index = run_queue_pop(own);
+        if (index == (size_t)-1) {
+            if (!steal_jobs(own)) return index;
+            continue;
+        }
+        if (job_states()[index] == JOB_RUNNABLE) return index;
+    }
+}
+
+// Give a job one slice on this dispatcher's slot
+static void percpu_run_slice(size_t index) {
+    int sliceMs = slice_for(index);
+    uint64_t start = schedBackend->now();
+    uint64_t deadline = start + (uint64_t)sliceMs * 1000000ull;
+    int pidfd = pidfd_open(job_pids()[index]);
+
+    bind_to_slot(index, currentSlot);
+    resume_job(index);
+    note_resumed(index, start);
+    job_info(index)->sliceMs = sliceMs;
+
+    // Wait out the slice without the table lock, returning early if the job exits
+    dispatch_clock_stop();
+    pthread_rwlock_unlock(&tableLock);
+    bool exited = false;
+    while (!exited) {
+        uint64_t now = schedBackend->now();
+        if (now >= deadline) break;
+        if (pidfd == -1) {
+            schedBackend->sleep_until(deadline);  // No pidfd: wait the whole slice
+            break;
+        }
+        struct pollfd fd = { .fd = pidfd, .events = POLLIN };
+        exited = poll(&fd, 1, (int)((deadline - now + 999999) / 1000000)) > 0 && fd.revents != 0;
+    }
+    pthread_rwlock_rdlock(&tableLock);
+    dispatch_clock_start();
+
+    uint64_t end = schedBackend->now();
+    if (pidfd != -1) close(pidfd);
+    if (!exited) stop_job(index);
+    job_info(index)->lastPausedTime = end;
+    if (!finish_slice(index, sliceMs)) adapt_slice(index, end - start);
+}
+
+static void *percpu_dispatcher(void *arg) {
+    RunQueue *own = arg;
+    currentSlot = own->slot;
+
+    pthread_rwlock_rdlock(&tableLock);
+    dispatch_clock_start();
+    while (atomic_load(&dispatchersRunning)) {
+        INSTRUMENT_BEGIN(pickStart);
+        size_t index = percpu_take(own);
+        INSTRUMENT_END(pickStart, currentSlot, PHASE_PICK);
+        if (index != (size_t)-1) {
+            percpu_run_slice(index);
+            continue;
+        }
+
+        // Idle: sleep until there is work, checking peers again every slice
+        dispatch_clock_stop();
+        pthread_rwlock_unlock(&tableLock);
+        struct timespec until;
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_nsec += (long)TSLICE * 1000000L;
+        until.tv_sec += until.tv_nsec / 1000000000L;
+        until.tv_nsec %= 1000000000L;
+        pthread_mutex_lock(&idleLock);
+        if (atomic_load(&dispatchersRunning) && percpuQueued == 0) {
+            idleDispatchers++;
+            pthread_cond_timedwait(&idleCond, &idleLock, &until);
+            idleDispatchers--;
+        }
+        pthread_mutex_unlock(&idleLock);
+        pthread_rwlock_rdlock(&tableLock);
+        dispatch_clock_start();
+    }
+    dispatch_clock_stop();
+    pthread_rwlock_unlock(&tableLock);
+    return NULL;
+}
+
+// Jobs the drain has entered, waiting for the main thread to spawn them. Only
+// the main thread touches the list.
+static uint32_t *pendingSpawns;
+static size_t pendingCount, pendingCapacity;
+
+static void pending_spawn(size_t index) {
+    if (pendingCount == pendingCapacity) {
+        size_t capacity = pendingCapacity ? 2 * pendingCapacity : 64;
+        uint32_t *grown = realloc(pendingSpawns, capacity * sizeof(uint32_t));
+        if (grown == NULL) {
+            perror("realloc");
+            fail_launch(index);  // It could never be spawned
+            return;
+        }
+        pendingSpawns = grown;
+        pendingCapacity = capacity;
+    }
+    pendingSpawns[pendingCount++] = (uint32_t)index;
+}
+
+// Spawn the pending jobs and hand them to the dispatchers. Runs on the main
+// thread with tableLock held shared, so the dispatchers keep running: the
+// drain has already sized everything a launch writes, and no other thread
+// spawns. A spawn that fails transiently stays pending, and is retried once
+// its backoff has passed.
+static void spawn_pending(void) {
+    uint64_t now = schedBackend->now();
+    journal_begin_batch();
+    for (size_t i = 0; i < pendingCount; i++) {
+        size_t index = pendingSpawns[i];
+        if (job_states()[index] == JOB_QUEUED && spawn_due(index, now)) launch_job(index);
+    }
+    journal_end_batch();  // Every spawn is durable before its job runs
+
+    size_t kept = 0;
+    for (size_t i = 0; i < pendingCount; i++) {
+        size_t index = pendingSpawns[i];
+        if (job_states()[index] == JOB_RUNNABLE) percpu_push(index);
+        else if (job_states()[index] == JOB_QUEUED) pendingSpawns[kept++] = (uint32_t)index;
+    }
+    pendingCount = kept;
+}
+
+// Per-CPU dispatch runs every job on one slot at a time, so it cannot
+// co-schedule a pipeline's stages; the shell refuses pipelines in this mode,
+// and any that reach the scheduler, as from a journal, are completed as failed
+static void refuse_gang(size_t leader) {
+    fprintf(stderr, "Pipelines are not supported with per-CPU dispatch; %s not run.\n",
+            job_info(leader)->executableName);
+    for (int stage = 0; stage < job_info(leader)->gangSize; stage++) {
+        size_t index = leader + stage;
+        if (job_states()[index] == JOB_DONE) continue;
+        if (job_states()[index] == JOB_RUNNABLE) kill(job_pids()[index], SIGKILL);
+        fail_launch(index);
+    }
+}
+
+// Main thread of per-CPU dispatch: feed submissions to the dispatchers until
+// every job has finished
+static void run_percpu(void) {
+    pthread_rwlockattr_t attr;
+    pthread_rwlockattr_init(&attr);
+    // Dispatchers take the lock shared all the time; let a waiting drain in
+    pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+    pthread_rwlock_init(&tableLock, &attr);
+    pthread_rwlockattr_destroy(&attr);
+
+    runQueues = calloc(NCPU, sizeof(RunQueue));
+    if (runQueues == NULL) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    atomic_store(&dispatchersRunning, true);
+    for (int i = 0; i < NCPU; i++) {
+        pthread_mutex_init(&runQueues[i].lock, NULL);
+        runQueues[i].slot = i;
+    }
+
+    for (int i = 0; i < NCPU; i++) {
+        int err = pthread_create(&runQueues[i].thread, NULL, percpu_dispatcher, &runQueues[i]);
+        if (err != 0) {
+            fprintf(stderr, "pthread_create: %s\n", strerror(err));
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    for (;;) {
+        pthread_rwlock_wrlock(&tableLock);
+        drain_submissions();
+        pthread_rwlock_unlock(&tableLock);
+        if (pendingCount > 0) {
+            pthread_rwlock_rdlock(&tableLock);
+            spawn_pending();
+            pthread_rwlock_unlock(&tableLock);
+        }
+        if (all_jobs_done(schedBackend->next_arrival())) {
+            if (wait_for_work(-1)) continue;
+            break;
+        }
+        // Completions are the dispatchers' business; check back every slice
+        if (!wait_for_work(TSLICE)) {
+            dispatch_clock_stop();
+            schedBackend->sleep_until(schedBackend->now() + (uint64_t)TSLICE * 1000000ull);
+            dispatch_clock_start();
+        }
+    }
+
+    atomic_store(&dispatchersRunning, false);
+    pthread_mutex_lock(&idleLock);
+    pthread_cond_broadcast(&idleCond);
+    pthread_mutex_unlock(&idleLock);
+    for (int i = 0; i < NCPU; i++) {
+        pthread_join(runQueues[i].thread, NULL);
+        pthread_mutex_destroy(&runQueues[i].lock);
+        free(runQueues[i].jobs);
+    }
+    free(runQueues);
+    runQueues = NULL;
+    free(pendingSpawns);
+    pendingSpawns = NULL;
+    pendingCount = pendingCapacity = 0;
+    pthread_rwlock_destroy(&tableLock);
+}
+
+void start_scheduler(SharedMemoryData *data, size_t size, int ncpu, int t_slice) {
+    static const char *dispatchNames[] = { "event-driven", "parallel", "serial", "per-CPU" };
+    static const char *policyNames[] = { "round-robin", "MLFQ", "SRTF", "EDF", "stride" };
+    static const char *sliceNames[] = { "fixed", "adaptive" };
+    log_at(LOG_SUMMARY, "Starting %s scheduler (%s dispatch, %s slices)...\n", policyNames[data->policy],
+           dispatchNames[data->dispatchMode], sliceNames[data->sliceMode]);
+
+    sharedData = data;
+    shared_size = size;
+    check_shared_layout(sharedData);
+    NCPU = ncpu;
+    TSLICE = t_slice;
+    if (sharedData->liveStats.startNs == 0) {
+        stats_begin(&sharedData->liveStats);
+        sharedData->liveStats.startNs = schedBackend->now();
+        stats_end(&sharedData->liveStats);
+    }
+
+    log_at(LOG_JOBS, "Ready Queue Size after initialization: %d\n", sharedData->readyQueue.readyQueueSize);
+    if (predicts_bursts() && burstHistoryPath != NULL) {
+        burst_history_load(burstHistoryPath);
+    }
+
+    // Pick up what a crashed scheduler left behind; the first drain enters it
+    if (journalPath != NULL && journal_recover(journalPath, &recoveredJobs, &recoveredCount) == 0) {
+        recoveryPending = journal_open(journalPath) == 0;
+        if (!recoveryPending) {
+            journal_free_jobs(recoveredJobs, recoveredCount);
+            recoveredJobs = NULL;
+        }
+    }
+
+    uint64_t idleSavedBefore = sharedData->idleTimeSavedNs;
+    dispatch_clock_start();
+    if (sharedData->dispatchMode == DISPATCH_EVENT) {
+        run_event_loop();
+    } else if (sharedData->dispatchMode == DISPATCH_PERCPU) {
+        run_percpu();
+    }
+
+    size_t batch[NCPU];
+    uint64_t lastBoost = schedBackend->now();
+
+    while (sharedData->dispatchMode != DISPATCH_EVENT && sharedData->dispatchMode != DISPATCH_PERCPU) {
+        drain_submissions();
+        uint64_t nextArrival = schedBackend->next_arrival();
+        if (all_jobs_done(nextArrival)) {
+            if (wait_for_work(-1)) continue;
+            break;
+        }
+
+        int batchCount = 0;
+        maybe_boost(schedBackend->now(), &lastBoost);
+
+        // Pick up to NCPU ready jobs for this round, a gang's stages counting one each
+        INSTRUMENT_BEGIN(pickStart);
+        while (batchCount < NCPU) {
+            int count = next_ready_unit(&batch[batchCount], NCPU - batchCount);
+            if (count == 0) {
+                if (heldGang == (size_t)-1) log_at(LOG_JOBS, "No processes in the ready queue.\n");
+                break;
+            }
+            batchCount += count;
+        }
+
+        batchCount = place_batch(batch, batchCount);
+        INSTRUMENT_END(pickStart, currentSlot, PHASE_PICK);
+
+        if (batchCount == 0) {
+            if (nextArrival != UINT64_MAX) {
+                dispatch_clock_stop();
+                schedBackend->sleep_until(nextArrival);  // Idle until the next job arrives
+                dispatch_clock_start();
+                continue;
+            }
+            if (wait_for_work(TSLICE)) continue;
+            log_at(LOG_SUMMARY, "No processes could be scheduled in this cycle.\n");
+            break;
+        }
+
+        if (sharedData->dispatchMode == DISPATCH_SERIAL) {
+            // One CPU at a time: each job, or gang, gets its own slice in turn
+            for (int i = 0; i < batchCount; i++) {
+                size_t unit[NCPU];
+                int count = 0;
+                if (batch[i] == (size_t)-1) continue;  // Ran with its gang
+                for (int j = i; j < batchCount; j++) {
+                    if (batch[j] != (size_t)-1 && same_unit(batch[i], batch[j])) unit[count++] = batch[j];
+                }
+                for (int j = i + 1; j < batchCount; j++) {
+                    if (batch[j] != (size_t)-1 && same_unit(batch[i], batch[j])) batch[j] = (size_t)-1;
+                }
+                run_slice(unit, count);
+            }
+        } else {
+            run_slice(batch, batchCount);
+        }
+    }
+    dispatch_clock_stop();
+
+    if (predicts_bursts() && burstHistoryPath != NULL) {
+        burst_history_save(burstHistoryPath);
+    }
+    journal_close(completedProcesses != sharedData->readyQueue.submittedProcess);
+
+    if (completedProcesses == sharedData->readyQueue.submittedProcess) {
+        log_at(LOG_SUMMARY, "All processes completed successfully.\n");
+    } else {
+        log_at(LOG_SUMMARY, "Scheduler finished but not all processes were completed.\n");
+    }
+    if (sharedData->dispatchMode == DISPATCH_EVENT) {
+        log_at(LOG_SUMMARY, "Idle CPU time avoided by early-exit detection: %.2f ms\n",
+               (sharedData->idleTimeSavedNs - idleSavedBefore) / 1e6);
+    }
+}
+
+
+
+
+// Function to handle child termination: reaps every exited job after a SIGCHLD
+void handle_child_termination(int sig) {
+    int status;
+    struct rusage usage;
+    pid_t pid;
+    while ((pid = wait4(-1, &status, WNOHANG, &usage)) > 0) {
+        size_t index = pid_index_lookup(pid);
+        if (index != (size_t)-1) {
+            cgroup_collect(index, &usage);
+            complete_process(index, status, &usage);
+        }
+    }
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Sort values and print their nearest-rank 50th, 95th and 99th percentiles
+static void print_percentiles(const char *label, double *values, int count) {
+    static const int ranks[] = { 50, 95, 99 };
+    double result[3];
+
+    qsort(values, count, sizeof(double), compare_doubles);
+    for (int r = 0; r < 3; r++) {
+        long long rank = ((long long)ranks[r] * count + 99) / 100;  // ceil(p * n / 100)
+        result[r] = values[rank > 0 ? rank - 1 : 0];
+    }
+    printf("%s p50/p95/p99: %.2f / %.2f / %.2f ms\n", label, result[0], result[1], result[2]);
+}
+
+// Copy the live statistics without ever making the scheduler wait: retry
+// until the copy was taken while no update was in progress
+static void read_live_stats(LiveStats *snapshot) {
+    const LiveStats *stats = &sharedData->liveStats;
+    uint32_t before, after;
+    do {
+        before = atomic_load_explicit(&stats->seq, memory_order_acquire);
+        memcpy(snapshot, (const void *)stats, sizeof(*snapshot));
+        atomic_thread_fence(memory_order_acquire);
+        after = atomic_load_explicit(&stats->seq, memory_order_relaxed);
+    } while ((before & 1) || before != after);
+}
+
+// Midpoint of a stats_bucket() histogram bucket, in milliseconds
+static double stats_bucket_ms(int bucket) {
+    if (bucket < STATS_SUB_BUCKETS) return bucket / 1e3;
+    int shift = bucket / STATS_SUB_BUCKETS - 1;
+    uint64_t low = (uint64_t)(STATS_SUB_BUCKETS + bucket % STATS_SUB_BUCKETS) << shift;
+    return (low + (1ull << shift) / 2.0) / 1e3;
+}
+
+// Nearest-rank 50th, 95th and 99th percentiles of a histogram, to bucket precision
+static void print_histogram_percentiles(const char *label, const uint32_t *histogram, uint64_t count) {
+    static const int ranks[] = { 50, 95, 99 };
+    double result[3] = { 0, 0, 0 };
+
+    for (int r = 0; r < 3; r++) {
+        uint64_t rank = (ranks[r] * count + 99) / 100;  // ceil(p * n / 100)
+        uint64_t seen = 0;
+        for (int b = 0; b < STATS_BUCKETS; b++) {
+            seen += histogram[b];
+            if (seen >= rank) {
+                result[r] = stats_bucket_ms(b);
+                break;
+            }
+        }
+    }
+    printf("%s p50/p95/p99: %.2f / %.2f / %.2f ms\n", label, result[0], result[1], result[2]);
+}
+
+void print_live_stats(void) {
+    LiveStats snapshot;
+    read_live_stats(&snapshot);
+    if (snapshot.startNs == 0) {
+        printf("The scheduler has not started yet.\n");
+        return;
+    }
+
+    uint64_t now = now_ns();
+    double uptime = (now - snapshot.startNs) / 1e9;
+    int running = 0;
+    for (int i = 0; i < sharedData->NCPU; i++) {
+        running += snapshot.slotSince[i] != 0;
+    }
+
+    printf("\nScheduler Stats (%.2f s):\n", uptime);
+    printf("Jobs: %llu submitted, %llu completed, %d running, %u ready\n",
+           (unsigned long long)snapshot.submitted, (unsigned long long)snapshot.completed, running, snapshot.readyJobs);
+    printf("Throughput: %.2f jobs/s\n", uptime > 0 ? snapshot.completed / uptime : 0);
+    printf("Slot utilization:");
+    for (int i = 0; i < sharedData->NCPU; i++) {
+        uint64_t busy = snapshot.slotBusyNs[i];
+        if (snapshot.slotSince[i] != 0 && now > snapshot.slotSince[i]) busy += now - snapshot.slotSince[i];
+        printf(" %d: %.1f%%", i, uptime > 0 ? 100.0 * busy / (now - snapshot.startNs) : 0);
+    }
+    printf("\n");
+    if (snapshot.completed > 0) {
+        print_histogram_percentiles("Wait Time", snapshot.waitHist, snapshot.completed);
+        print_histogram_percentiles("Turnaround Time", snapshot.turnaroundHist, snapshot.completed);
+    }
+}
+
+// Function to print job details after scheduling. Times are in milliseconds;
+// arrival is relative to the first submitted job.
+// Slices a finished job would have needed at a fixed TSLICE for the time it
+// ran, minus the slices it actually got; negative when adaptive slices split
+// its run more finely
+static long long switches_saved(const ProcessInfo *process) {
+    if (process->slices == 0) return 0;  // Exited before its first slice
+    uint64_t sliceNs = (uint64_t)sharedData->TSLICE * 1000000ull;
+    uint64_t ranNs = process->end_time - process->arrival_time - process->wait_time;
+    long long fixedSlices = ranNs > 0 ? (ranNs + sliceNs - 1) / sliceNs : 1;
+    return fixedSlices - process->slices;
+}
+
+// One end of a finished job's time in the system, for print_stride_shares()
+typedef struct {
+    uint64_t ns;
+    size_t index;
+    int arrives;              // 1 at arrival, 0 at exit
+} ShareEvent;
+
+static int compare_share_events(const void *a, const void *b) {
+    const ShareEvent *x = a, *y = b;
+    if (x->ns != y->ns) return x->ns < y->ns ? -1 : 1;
+    return x->arrives - y->arrives;  // Exits first, so a job never competes with one that left as it came
+}
+
+// Stride: each finished job's achieved CPU share, the slot time it got over
+// its time in the system, against its target. While more jobs are in the
+// system than there are slots, the target is its tickets' fraction of the
+// tickets of every job there, times the slots; otherwise it is a whole slot.
+// A sweep over arrivals and exits integrates this for all jobs in O(n log n).
+static void print_stride_shares(void) {
+    int slots = sharedData->dispatchMode == DISPATCH_SERIAL ? 1 : sharedData->NCPU;  // Serial runs one job at a time
+    size_t count = 0;
+    ShareEvent *events = malloc(2 * sharedData->jobCount * sizeof(ShareEvent));
+    double *joinedAt = malloc(2 * sharedData->jobCount * sizeof(double));  // Per job: share integral, then full-slot time, at arrival
+    if (events == NULL || joinedAt == NULL) {
+        perror("malloc");
+        free(events);
+        free(joinedAt);
+        return;
+    }
+    for (size_t i = 0; i < sharedData->jobCount; i++) {
+        if (job_pids()[i] <= 0 || job_info(i)->end_time == 0) continue;
+        events[count++] = (ShareEvent){ job_info(i)->arrival_time, i, 1 };
+        events[count++] = (ShareEvent){ job_info(i)->end_time, i, 0 };
+    }
+    qsort(events, count, sizeof(ShareEvent), compare_share_events);
+
+    printf("\nStride Shares (CPU share while in the system):\n");
+    printf("| Name              | PID     | Tickets | Target  | Achieved |\n");
+    double perTicket = 0;     // Integral of slots / total tickets over contended time
+    double uncontended = 0;   // Time with no more jobs than slots
+    double totalError = 0;
+    uint64_t last = count > 0 ? events[0].ns : 0;
+    long long tickets = 0;
+    int present = 0, reported = 0;
+    for (size_t e = 0; e < count; e++) {
+        double span = (events[e].ns - last) / 1e9;
+        if (present > slots) perTicket += span * slots / tickets;
+        else uncontended += span;
+        last = events[e].ns;
+
+        size_t index = events[e].index;
+        if (events[e].arrives) {
+            joinedAt[2 * index] = perTicket;
+            joinedAt[2 * index + 1] = uncontended;
+            tickets += stride_tickets(index);
+            present++;
+            continue;
+        }
+        tickets -= stride_tickets(index);
+        present--;
+
+        const ProcessInfo *process = job_info(index);
+        double lifetime = (process->end_time - process->arrival_time) / 1e9;
+        if (lifetime <= 0) continue;
+        double target = (stride_tickets(index) * (perTicket - joinedAt[2 * index]) +
+                         uncontended - joinedAt[2 * index + 1]) / lifetime;
+        if (target > 1) target = 1;
+        double achieved = (process->end_time - process->arrival_time - process->wait_time) / 1e9 / lifetime;
+        totalError += achieved > target ? achieved - target : target - achieved;
+        reported++;
+        printf("| %-16s | %-7d | %7d | %6.1f%% | %7.1f%% |\n", process->executableName, job_pids()[index],
+               stride_tickets(index), 100 * target, 100 * achieved);
+    }
+    if (reported > 0) {
+        printf("Mean share error: %.1f percentage points\n", 100 * totalError / reported);
+    }
+    free(events);
+    free(joinedAt);
+}
+
+// Finished jobs that missed their deadline, the latest first, at most ten
+static void print_missed_deadlines(void) {
+    size_t missed[10];
+    int count = 0, total = 0;
+    for (size_t i = 0; i < sharedData->jobCount; i++) {
+        const ProcessInfo *process = job_info(i);
+        if (job_pids()[i] <= 0 || process->deadlineNs == 0 || process->end_time <= process->deadlineNs) continue;
+        total++;
+
+        // Insertion into the short list, ordered by lateness
+        uint64_t late = process->end_time - process->deadlineNs;
+        int pos = count < 10 ? count++ : 10;
+        while (pos > 0 && job_info(missed[pos - 1])->end_time - job_info(missed[pos - 1])->deadlineNs < late) {
+            if (pos < 10) missed[pos] = missed[pos - 1];
+            pos--;
+        }
+        if (pos < 10) missed[pos] = i;
+    }
+    for (int k = 0; k < count; k++) {
+        const ProcessInfo *process = job_info(missed[k]);
+        printf("  Missed: %s (PID %d) finished %.2f ms late\n", process->executableName, job_pids()[missed[k]],
+               (process->end_time - process->deadlineNs) / 1e6);
+    }
+    if (total > count) printf("  ... and %d more\n", total - count);
+}
+
+void print_job_details() {
+    printf("\nJob Details:\n");
+    printf("---------------------------------------------------------------------------------------------------------------------------------------------------------------------------\n");
+    printf("| Name              | PID     | Turnaround | Wait      | Response  | CPU User  | CPU Sys   | Mem Peak  | Spawn     | Arrival   | Slice  | Migrations | Warm Resumes |\n");
+    printf("---------------------------------------------------------------------------------------------------------------------------------------------------------------------------\n");
+    sync_shared_memory();
+    uint64_t firstArrival = UINT64_MAX;
+    for (size_t i = 0; i < sharedData->jobCount; i++) {
+        if (job_pids()[i] > 0 && job_info(i)->arrival_time < firstArrival) {
+            firstArrival = job_info(i)->arrival_time;
+        }
+    }
+
+    double totalWaitTime = 0;
+    double totalTurnaroundTime = 0;
+    double totalResponseTime = 0;
+    double totalSpawnTime = 0;
+    long long switchesSaved = 0, switchesAdded = 0;
+    double totalPredictionError = 0;
+    int deadlineJobs = 0, deadlinesMet = 0;
+    double worstLateness = 0;
+    int spawned = 0;
+    int finished = 0;
+    double *waits = malloc(sharedData->jobCount * sizeof(double));
+    double *turnarounds = malloc(sharedData->jobCount * sizeof(double));
+    double *responses = malloc(sharedData->jobCount * sizeof(double));
+    for (size_t i = 0; i < sharedData->jobCount; i++) {
+        if (job_pids()[i] > 0) {
+            ProcessInfo *process = job_info(i);
+            totalSpawnTime += process->spawnNs / 1e6;
+            spawned++;
+            double waitTime = process->wait_time / 1e6;
+            double arrivalTime = (process->arrival_time - firstArrival) / 1e6;
+            double responseTime = process->start_time ? (process->start_time - process->arrival_time) / 1e6 : 0;
+            double turnaroundTime = process->end_time ? (process->end_time - process->arrival_time) / 1e6 : 0;
+            if (process->end_time) {
+                totalWaitTime += waitTime;
+                totalTurnaroundTime += turnaroundTime;
+                totalResponseTime += responseTime;
+                long long saved = switches_saved(process);
+                if (saved > 0) switchesSaved += saved;
+                else switchesAdded -= saved;
+                double predictionError = process->predictedMs - (process->cpuUserNs + process->cpuSysNs) / 1e6;
+                totalPredictionError += predictionError < 0 ? -predictionError : predictionError;
+                if (process->deadlineNs != 0) {
+                    deadlineJobs++;
+                    if (process->end_time <= process->deadlineNs) {
+                        deadlinesMet++;
+                    } else if ((process->end_time - process->deadlineNs) / 1e6 > worstLateness) {
+                        worstLateness = (process->end_time - process->deadlineNs) / 1e6;
+                    }
+                }
+                if (waits && turnarounds && responses) {
+                    waits[finished] = waitTime;
+                    turnarounds[finished] = turnaroundTime;
+                    responses[finished] = responseTime;
+                }
+                finished++;
+            }
+            printf("| %-16s | %-7d | %10.2f | %9.2f | %9.2f | %9.2f | %9.2f | %9.2f | %9.3f | %9.2f | %6d | %-10d | %-12d |\n",
+                   process->executableName, job_pids()[i], turnaroundTime, waitTime, responseTime,
+                   process->cpuUserNs / 1e6, process->cpuSysNs / 1e6, process->memoryPeakKb / 1024.0,
+                   process->spawnNs / 1e6, arrivalTime,
+                   process->sliceMs, process->migrations, process->warmResumes);
+        }
+    }
+    printf("---------------------------------------------------------------------------------------------------------------------------------------------------------------------------\n");
+    if (finished > 0) {
+        printf("Average Wait Time: %.2f ms\n", totalWaitTime / finished);
+        printf("Average Turnaround Time: %.2f ms\n", totalTurnaroundTime / finished);
+        printf("Average Response Time: %.2f ms\n", totalResponseTime / finished);
+        printf("Average Spawn Latency: %.3f ms\n", totalSpawnTime / spawned);
+        if (waits && turnarounds && responses) {
+            print_percentiles("Wait Time", waits, finished);
+            print_percentiles("Turnaround Time", turnarounds, finished);
+            print_percentiles("Response Time", responses, finished);
+        }
+        if (sharedData->policy == POLICY_SRTF) {
+            printf("Mean burst prediction error: %.2f ms\n", totalPredictionError / finished);
+        }
+        if (deadlineJobs > 0) {
+            printf("Deadlines: %d met, %d missed of %d (%.1f%% met)", deadlinesMet, deadlineJobs - deadlinesMet,
+                   deadlineJobs, 100.0 * deadlinesMet / deadlineJobs);
+            if (deadlinesMet < deadlineJobs) printf(", worst by %.2f ms", worstLateness);
+            printf("\n");
+            print_missed_deadlines();
+        }
+        if (sharedData->policy == POLICY_STRIDE) print_stride_shares();
+        if (sharedData->sliceMode == SLICE_ADAPTIVE) {
+            printf("Context switches saved by adaptive slices: %lld by longer slices, %lld added by shorter ones "
+                   "(vs. fixed %d ms slices)\n", switchesSaved, switchesAdded, (int)sharedData->TSLICE);
+        }
+    } else {
+        printf("No processes completed.\n");
+    }
+    free(waits);
+    free(turnarounds);
+    free(responses);
+#ifdef SCHED_INSTRUMENT
+    print_instrument_report();
+#endif
+}
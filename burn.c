@@ -0,0 +1,51 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <unistd.h>
+#include <time.h>
+#include "burn.h"
+
+static int reportFd = -1;
+
+static uint64_t clock_ns(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// clock_gettime and write are async-signal-safe, so this may run from a handler
+static void report(BurnEvent event) {
+    BurnRecord record = { getpid(), event, clock_ns(CLOCK_MONOTONIC) };
+    if (write(reportFd, &record, sizeof(record)) == -1) {
+        reportFd = -1;
+    }
+}
+
+static void handle_continue(int sig) {
+    if (reportFd != -1) report(BURN_RESUMED);
+}
+
+int main() {
+    const char *fd = getenv(BURN_REPORT_FD_ENV);
+    if (fd != NULL) {
+        reportFd = atoi(fd);
+
+        // Installed before the started record, so every continue after it is reported
+        struct sigaction sa = {0};
+        sa.sa_handler = handle_continue;
+        sa.sa_flags = SA_RESTART;
+        sigaction(SIGCONT, &sa, NULL);
+        report(BURN_STARTED);
+    }
+
+    const char *ms = getenv(BURN_MS_ENV);
+    uint64_t burstNs = (uint64_t)((ms != NULL ? atof(ms) : BURN_DEFAULT_MS) * 1e6);
+
+    // Spin on CPU time, so time spent stopped does not count towards the burst
+    uint64_t start = clock_ns(CLOCK_PROCESS_CPUTIME_ID);
+    volatile unsigned long sink = 0;
+    while (clock_ns(CLOCK_PROCESS_CPUTIME_ID) - start < burstNs) {
+        for (int i = 0; i < 10000; i++) sink += i;
+    }
+    return 0;
+}
@@ -0,0 +1,26 @@
+#ifndef BURN_H
+#define BURN_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+// Synthetic CPU-bound workload for the benchmarks. It burns BURN_MS
+// milliseconds of CPU time (default 100) and exits. If BURN_REPORT_FD names
+// an open descriptor, it writes a BurnRecord there when it starts and each
+// time it is continued.
+#define BURN_MS_ENV "BURN_MS"
+#define BURN_REPORT_FD_ENV "BURN_REPORT_FD"
+#define BURN_DEFAULT_MS 100
+
+typedef enum {
+    BURN_STARTED = 0,         // main() was entered
+    BURN_RESUMED              // The SIGCONT handler ran
+} BurnEvent;
+
+typedef struct {
+    pid_t pid;
+    int event;                // BurnEvent
+    uint64_t ns;              // CLOCK_MONOTONIC ns
+} BurnRecord;
+
+#endif // BURN_H
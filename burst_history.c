@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include "burst_history.h"
+
+typedef struct {
+    char *name;               // NULL marks an empty bucket
+    double predictedMs;
+    unsigned int samples;     // Runs folded into the average
+} BurstEntry;
+
+// Open-addressing table with linear probing, kept at most half full
+static BurstEntry *table;
+static size_t buckets;
+static size_t used;
+
+static uint32_t hash_name(const char *name) {
+    uint32_t hash = 2166136261u;  // FNV-1a
+    for (const unsigned char *c = (const unsigned char *)name; *c; c++) {
+        hash = (hash ^ *c) * 16777619u;
+    }
+    return hash;
+}
+
+static BurstEntry *find_bucket(BurstEntry *entries, size_t count, const char *name) {
+    size_t bucket = hash_name(name) & (count - 1);
+    while (entries[bucket].name != NULL && strcmp(entries[bucket].name, name) != 0) {
+        bucket = (bucket + 1) & (count - 1);
+    }
+    return &entries[bucket];
+}
+
+// Double the table (or create it) so one more entry keeps it at most half full
+static int reserve_entry(void) {
+    if (2 * (used + 1) <= buckets) return 0;
+
+    size_t newBuckets = buckets ? 2 * buckets : 64;
+    BurstEntry *entries = calloc(newBuckets, sizeof(BurstEntry));
+    if (entries == NULL) {
+        perror("calloc");
+        return -1;
+    }
+    for (size_t i = 0; i < buckets; i++) {
+        if (table[i].name != NULL) *find_bucket(entries, newBuckets, table[i].name) = table[i];
+    }
+    free(table);
+    table = entries;
+    buckets = newBuckets;
+    return 0;
+}
+
+static BurstEntry *lookup(const char *name) {
+    if (buckets == 0) return NULL;
+    BurstEntry *entry = find_bucket(table, buckets, name);
+    return entry->name != NULL ? entry : NULL;
+}
+
+double burst_history_predict(const char *name, double defaultMs) {
+    BurstEntry *entry = lookup(name);
+    return entry != NULL ? entry->predictedMs : defaultMs;
+}
+
+// Set an entry to a value, creating it if needed; returns NULL if out of memory
+static BurstEntry *store(const char *name, double predictedMs, unsigned int samples) {
+    BurstEntry *entry = lookup(name);
+    if (entry == NULL) {
+        if (reserve_entry() == -1) return NULL;
+        entry = find_bucket(table, buckets, name);
+        entry->name = strdup(name);
+        if (entry->name == NULL) return NULL;
+        used++;
+    }
+    entry->predictedMs = predictedMs;
+    entry->samples = samples;
+    return entry;
+}
+
+void burst_history_update(const char *name, double burstMs) {
+    BurstEntry *entry = lookup(name);
+    if (entry == NULL) {
+        store(name, burstMs, 1);
+    } else {
+        entry->predictedMs = BURST_EWMA_WEIGHT * burstMs + (1 - BURST_EWMA_WEIGHT) * entry->predictedMs;
+        entry->samples++;
+    }
+}
+
+// File format, one executable per line: <predicted-ms> <samples> <name>
+int burst_history_load(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        if (errno == ENOENT) return 0;
+        perror(path);
+        return -1;
+    }
+
+    char line[512];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        double predictedMs;
+        unsigned int samples;
+        int nameStart;
+        if (line[0] == '#' || sscanf(line, "%lf %u %n", &predictedMs, &samples, &nameStart) != 2) continue;
+
+        char *name = line + nameStart;
+        name[strcspn(name, "\n")] = '\0';
+        if (*name != '\0' && predictedMs >= 0) store(name, predictedMs, samples);
+    }
+    fclose(file);
+    return 0;
+}
+
+// Written to a temporary file and renamed over path, so a crash never leaves a truncated history
+int burst_history_save(const char *path) {
+    char tmpPath[4096];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+    FILE *file = fopen(tmpPath, "w");
+    if (file == NULL) {
+        perror(tmpPath);
+        return -1;
+    }
+
+    fprintf(file, "# SimpleScheduler burst history: <predicted-ms> <samples> <executable>\n");
+    for (size_t i = 0; i < buckets; i++) {
+        if (table[i].name != NULL) {
+            fprintf(file, "%.3f %u %s\n", table[i].predictedMs, table[i].samples, table[i].name);
+        }
+    }
+    if (fclose(file) != 0 || rename(tmpPath, path) == -1) {
+        perror(path);
+        unlink(tmpPath);
+        return -1;
+    }
+    return 0;
+}
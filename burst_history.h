@@ -0,0 +1,28 @@
+#ifndef BURST_HISTORY_H
+#define BURST_HISTORY_H
+
+// Per-executable CPU burst history used by SRTF to predict how long a job will
+// run. Each executable name keeps an exponentially weighted average of the CPU
+// time its past runs used:
+//     prediction = BURST_EWMA_WEIGHT * lastBurst + (1 - BURST_EWMA_WEIGHT) * prediction
+// The table lives in the scheduler's own memory and can be saved to a text
+// file so that predictions carry over from one shell session to the next.
+
+#define BURST_EWMA_WEIGHT 0.5
+#define BURST_HISTORY_FILE ".simplescheduler_history" // Default file name, in $HOME
+#define BURST_HISTORY_ENV "SIMPLESCHEDULER_HISTORY"  // Overrides the default path
+
+// Predicted burst in ms for an executable, or defaultMs if it has never run
+double burst_history_predict(const char *name, double defaultMs);
+
+// Fold the CPU time a finished run of name used into its average
+void burst_history_update(const char *name, double burstMs);
+
+// Merge the entries saved in path into the table; a missing file is not an error.
+// Returns -1 if the file exists but cannot be read.
+int burst_history_load(const char *path);
+
+// Replace path with the current table; returns -1 on failure
+int burst_history_save(const char *path);
+
+#endif // BURST_HISTORY_H
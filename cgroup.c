@@ -0,0 +1,297 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include "shared_memory.h"
+#include "scheduler.h"
+
+// cgroup v2 backend. Every launched job gets its own leaf cgroup under a
+// per-scheduler directory, so the job and anything it forks are one unit:
+//
+// - slices start and end by writing cgroup.freeze instead of sending signals,
+//   which stops or thaws every process in the job at once;
+// - CPU time comes from the leaf's cpu.stat and memory from memory.peak, both
+//   covering the whole process tree rather than what wait4() reports for the
+//   job's main process;
+// - where the cpu controller is available, cpu.max caps the job at its
+//   priority's share of the one slot it holds, however many processes it
+//   runs: priority MAX_PRIORITY gets the whole CPU, lower ones a fraction.
+//
+// Jobs run through the process backend for everything else (spawning, exit
+// notification), and a job whose leaf cannot be set up falls back to signals.
+
+#define CGROUP_CPU_PERIOD_US 100000  // cpu.max period; the quota is the job's share of it
+#define CGROUP_CPU_MIN_QUOTA_US 1000 // The smallest quota the kernel accepts
+
+static char rootPath[PATH_MAX];      // Directory holding this scheduler's job leaves, empty if unused
+static int hasCpuMax;
+static int hasMemoryPeak;
+static uint8_t *attached;            // attached[i] is 1 while job i is in its leaf
+static size_t attachedCapacity;
+
+static int write_file(const char *path, const char *text) {
+    int fd = open(path, O_WRONLY | O_CLOEXEC);
+    if (fd == -1) return -1;
+    ssize_t written = write(fd, text, strlen(text));
+    close(fd);
+    return written == (ssize_t)strlen(text) ? 0 : -1;
+}
+
+// Path of a job's leaf, or of file in it; -1 if it does not fit in size
+static int leaf_path(char *path, size_t size, size_t index, const char *file) {
+    int length = snprintf(path, size, "%s/job-%zu%s%s", rootPath, index, file[0] ? "/" : "", file);
+    return length >= 0 && (size_t)length < size ? 0 : -1;
+}
+
+static void write_leaf(size_t index, const char *file, const char *text) {
+    char path[PATH_MAX];
+    if (leaf_path(path, sizeof(path), index, file) == -1 || write_file(path, text) == -1) perror(path);
+}
+
+// Mount point of the cgroup v2 hierarchy, from /proc/self/mountinfo
+static int find_cgroup2_mount(char *mount, size_t size) {
+    FILE *file = fopen("/proc/self/mountinfo", "r");
+    if (file == NULL) return -1;
+
+    char line[1024];
+    int found = -1;
+    while (found == -1 && fgets(line, sizeof(line), file) != NULL) {
+        char mountPoint[PATH_MAX], fsType[64];
+        char *separator = strstr(line, " - ");
+        if (separator == NULL || sscanf(separator + 3, "%63s", fsType) != 1) continue;
+        if (strcmp(fsType, "cgroup2") == 0 && sscanf(line, "%*s %*s %*s %*s %4095s", mountPoint) == 1) {
+            snprintf(mount, size, "%s", mountPoint);
+            found = 0;
+        }
+    }
+    fclose(file);
+    return found;
+}
+
+// This process's cgroup v2 path, from the "0::" line of /proc/self/cgroup
+static int find_own_cgroup(char *path, size_t size) {
+    FILE *file = fopen("/proc/self/cgroup", "r");
+    if (file == NULL) return -1;
+
+    char line[PATH_MAX + 8];
+    int found = -1;
+    while (found == -1 && fgets(line, sizeof(line), file) != NULL) {
+        if (strncmp(line, "0::", 3) != 0) continue;
+        line[strcspn(line, "\n")] = '\0';
+        int length = snprintf(path, size, "%s", strcmp(line + 3, "/") == 0 ? "" : line + 3);
+        found = length >= 0 && (size_t)length < size ? 0 : -1;
+        break;
+    }
+    fclose(file);
+    return found;
+}
+
+static int cgroup_launch(size_t index);
+static void cgroup_resume(size_t index);
+static void cgroup_stop(size_t index);
+static int cgroup_reap(size_t index, int *status, struct rusage *usage);
+static uint64_t cgroup_cpu_time(size_t index);
+
+int cgroup_backend_init(void) {
+    char mount[PATH_MAX], own[PATH_MAX], path[PATH_MAX + 32];
+    if (find_cgroup2_mount(mount, sizeof(mount)) == -1 || find_own_cgroup(own, sizeof(own)) == -1) {
+        fprintf(stderr, "No cgroup v2 hierarchy found; using signals.\n");
+        return -1;
+    }
+
+    int length = snprintf(rootPath, sizeof(rootPath), "%s%s/simplescheduler-%d", mount, own, getpid());
+    if (length >= (int)sizeof(rootPath) || mkdir(rootPath, 0755) == -1) {
+        perror(rootPath);
+        fprintf(stderr, "cgroup v2 is not writable; using signals.\n");
+        rootPath[0] = '\0';
+        return -1;
+    }
+
+    snprintf(path, sizeof(path), "%s/cgroup.freeze", rootPath);
+    if (access(path, W_OK) == -1) {
+        fprintf(stderr, "cgroup freezer not available; using signals.\n");
+        rmdir(rootPath);
+        rootPath[0] = '\0';
+        return -1;
+    }
+
+    // Delegate cpu and memory to the job leaves where the parent makes them available
+    snprintf(path, sizeof(path), "%s/cgroup.subtree_control", rootPath);
+    hasCpuMax = write_file(path, "+cpu") == 0;
+    hasMemoryPeak = write_file(path, "+memory") == 0;
+
+    log_at(LOG_SUMMARY, "Using cgroup v2 job control under %s (cpu.max %s, memory.peak %s)\n", rootPath,
+           hasCpuMax ? "enforced" : "unavailable", hasMemoryPeak ? "recorded" : "unavailable");
+
+    // Exit notification, sleeping and the clock stay with the process backend
+    static SchedBackend cgroupBackend;
+    cgroupBackend = processBackend;
+    cgroupBackend.launch = cgroup_launch;
+    cgroupBackend.resume = cgroup_resume;
+    cgroupBackend.stop = cgroup_stop;
+    cgroupBackend.reap = cgroup_reap;
+    cgroupBackend.cpu_time = cgroup_cpu_time;
+    schedBackend = &cgroupBackend;
+    return 0;
+}
+
+void cgroup_backend_release(void) {
+    if (rootPath[0] == '\0') return;
+
+    // Leaves of jobs that never exited cleanly are removed here
+    for (size_t i = 0; i < attachedCapacity; i++) {
+        char path[PATH_MAX];
+        if (!attached[i]) continue;
+        if (leaf_path(path, sizeof(path), i, "") == 0) rmdir(path);
+    }
+    if (rmdir(rootPath) == -1) perror(rootPath);
+    rootPath[0] = '\0';
+}
+
+static int is_attached(size_t index) {
+    return index < attachedCapacity && attached[index];
+}
+
+void cgroup_reserve(size_t capacity) {
+    if (rootPath[0] == '\0' || capacity <= attachedCapacity) return;
+    uint8_t *grown = realloc(attached, capacity);
+    if (grown == NULL) {
+        perror("realloc");
+        return;  // Jobs past the old capacity are driven with signals
+    }
+    memset(grown + attachedCapacity, 0, capacity - attachedCapacity);
+    attached = grown;
+    attachedCapacity = capacity;
+}
+
+// cpu.max quota of a job: its priority's share of a slot, as
+// quota = period * priority / MAX_PRIORITY, out-of-range priorities clamped
+static int cpu_quota_us(size_t index) {
+    int priority = job_priorities()[index];
+    if (priority < MIN_PRIORITY) priority = MIN_PRIORITY;
+    if (priority > MAX_PRIORITY) priority = MAX_PRIORITY;
+    int quota = CGROUP_CPU_PERIOD_US / MAX_PRIORITY * priority;
+    return quota > CGROUP_CPU_MIN_QUOTA_US ? quota : CGROUP_CPU_MIN_QUOTA_US;
+}
+
+// Move a freshly launched, still stopped job into its own leaf, frozen, and
+// clear its SIGSTOP so that from now on only the freezer holds it
+static void attach_job(size_t index) {
+    char path[PATH_MAX], text[64];
+
+    if (index >= attachedCapacity) return;  // cgroup_reserve() ran out of memory
+
+    // Every file the leaf is driven through is as short as cgroup.freeze or shorter
+    if (leaf_path(path, sizeof(path), index, "cgroup.freeze") == -1) {
+        fprintf(stderr, "cgroup path too long for %s; using signals.\n", job_info(index)->executableName);
+        return;
+    }
+    if (leaf_path(path, sizeof(path), index, "") == -1 || mkdir(path, 0755) == -1) {
+        perror(path);
+        return;
+    }
+    if (leaf_path(path, sizeof(path), index, "cgroup.freeze") == -1 || write_file(path, "1") == -1) {
+        perror(path);
+        if (leaf_path(path, sizeof(path), index, "") == 0) rmdir(path);
+        return;
+    }
+    snprintf(text, sizeof(text), "%d", job_pids()[index]);
+    if (leaf_path(path, sizeof(path), index, "cgroup.procs") == -1 || write_file(path, text) == -1) {
+        perror(path);
+        if (leaf_path(path, sizeof(path), index, "") == 0) rmdir(path);
+        return;
+    }
+    if (hasCpuMax) {
+        snprintf(text, sizeof(text), "%d %d", cpu_quota_us(index), CGROUP_CPU_PERIOD_US);
+        write_leaf(index, "cpu.max", text);
+    }
+
+    attached[index] = 1;
+    kill(job_pids()[index], SIGCONT);  // Frozen, so it still cannot run
+}
+
+static int cgroup_launch(size_t index) {
+    if (processBackend.launch(index) == -1) return -1;
+    if (job_states()[index] == JOB_RUNNABLE) attach_job(index);
+    return 0;
+}
+
+static void cgroup_resume(size_t index) {
+    if (is_attached(index)) {
+        write_leaf(index, "cgroup.freeze", "0");
+    } else {
+        processBackend.resume(index);
+    }
+}
+
+static void cgroup_stop(size_t index) {
+    if (is_attached(index)) {
+        write_leaf(index, "cgroup.freeze", "1");
+    } else {
+        processBackend.stop(index);
+    }
+}
+
+// Read one "key value" line of a leaf's cpu.stat; returns UINT64_MAX if absent
+static uint64_t read_cpu_stat(size_t index, const char *key) {
+    char path[PATH_MAX], name[64];
+    unsigned long long value;
+    uint64_t result = UINT64_MAX;
+
+    if (leaf_path(path, sizeof(path), index, "cpu.stat") == -1) return result;
+    FILE *file = fopen(path, "r");
+    if (file == NULL) return result;
+    while (fscanf(file, "%63s %llu", name, &value) == 2) {
+        if (strcmp(name, key) == 0) {
+            result = value;
+            break;
+        }
+    }
+    fclose(file);
+    return result;
+}
+
+static uint64_t cgroup_cpu_time(size_t index) {
+    if (!is_attached(index)) return processBackend.cpu_time(index);
+    uint64_t usec = read_cpu_stat(index, "usage_usec");
+    return usec == UINT64_MAX ? usec : usec * 1000;
+}
+
+void cgroup_collect(size_t index, struct rusage *usage) {
+    char path[PATH_MAX];
+    if (!is_attached(index)) return;
+
+    // The job is over once its main process exits; end whatever it left behind
+    if (leaf_path(path, sizeof(path), index, "cgroup.kill") == 0 && access(path, W_OK) == 0) write_file(path, "1");
+
+    uint64_t userUsec = read_cpu_stat(index, "user_usec");
+    uint64_t systemUsec = read_cpu_stat(index, "system_usec");
+    if (userUsec != UINT64_MAX && systemUsec != UINT64_MAX) {
+        usage->ru_utime.tv_sec = userUsec / 1000000;
+        usage->ru_utime.tv_usec = userUsec % 1000000;
+        usage->ru_stime.tv_sec = systemUsec / 1000000;
+        usage->ru_stime.tv_usec = systemUsec % 1000000;
+    }
+    if (hasMemoryPeak && leaf_path(path, sizeof(path), index, "memory.peak") == 0) {
+        FILE *file = fopen(path, "r");
+        unsigned long long peak;
+        if (file != NULL) {
+            if (fscanf(file, "%llu", &peak) == 1) usage->ru_maxrss = peak / 1024;
+            fclose(file);
+        }
+    }
+
+    // Fails while killed leftovers are still exiting; cgroup_backend_release retries
+    if (leaf_path(path, sizeof(path), index, "") == 0 && rmdir(path) == 0) attached[index] = 0;
+}
+
+static int cgroup_reap(size_t index, int *status, struct rusage *usage) {
+    if (!processBackend.reap(index, status, usage)) return 0;
+    cgroup_collect(index, usage);
+    return 1;
+}
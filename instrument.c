@@ -0,0 +1,169 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "instrument.h"
+
+// Phase report and per-job perf_event counters of make INSTRUMENT=1 builds.
+// Without SCHED_INSTRUMENT this file compiles to nothing.
+
+#ifdef SCHED_INSTRUMENT
+
+bool perfEventsEnabled = false;
+
+static const char *phaseNames[NUM_PHASES] = { "drain", "pick", "spawn", "resume", "stop", "reap", "wait", "log" };
+
+static const struct {
+    uint32_t type;
+    uint64_t config;
+    const char *name;
+} perfCounters[NUM_PERF_COUNTERS] = {
+    { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, "context switches" },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "cycles" },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, "cache misses" },
+};
+
+// Counter fds of the scheduler's jobs, indexed by job; -1 where a counter could not be opened.
+// Grown only by perf_jobs_reserve(), while the job table is held exclusively.
+static int (*perfFds)[NUM_PERF_COUNTERS];
+static size_t perfFdsCapacity;
+static bool perfWarned[NUM_PERF_COUNTERS];
+
+static int perf_event_open(struct perf_event_attr *attr, pid_t pid) {
+    return (int)syscall(SYS_perf_event_open, attr, pid, -1, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+// A job's fds, NULL if none were opened: entries start zeroed, and fd 0 is always our stdin
+static int *perf_fds(size_t index) {
+    return index < perfFdsCapacity && perfFds[index][0] != 0 ? perfFds[index] : NULL;
+}
+
+void perf_jobs_reserve(size_t capacity) {
+    if (capacity <= perfFdsCapacity) return;
+    void *grown = realloc(perfFds, capacity * sizeof(*perfFds));
+    if (grown == NULL) {
+        perror("realloc");
+        return;  // Jobs past the old capacity run uncounted
+    }
+    perfFds = grown;
+    memset(perfFds + perfFdsCapacity, 0, (capacity - perfFdsCapacity) * sizeof(*perfFds));
+    perfFdsCapacity = capacity;
+}
+
+void perf_job_open(size_t index) {
+    if (index >= perfFdsCapacity) return;  // perf_jobs_reserve() ran out of memory
+
+    // Context switches happen in the kernel and are counted there; the rest
+    // count user space only, which perf_event_paranoid 2 still allows for our own jobs
+    for (int i = 0; i < NUM_PERF_COUNTERS; i++) {
+        struct perf_event_attr attr = {0};
+        attr.size = sizeof(attr);
+        attr.type = perfCounters[i].type;
+        attr.config = perfCounters[i].config;
+        attr.disabled = 1;
+        attr.exclude_kernel = perfCounters[i].type != PERF_TYPE_SOFTWARE;
+        attr.exclude_hv = 1;
+        perfFds[index][i] = perf_event_open(&attr, job_pids()[index]);
+        if (perfFds[index][i] == -1 && !perfWarned[i]) {
+            fprintf(stderr, "perf_event_open (%s): %s; not counted.\n", perfCounters[i].name, strerror(errno));
+            perfWarned[i] = true;
+        }
+    }
+}
+
+void perf_job_enable(size_t index) {
+    int *fds = perf_fds(index);
+    if (fds == NULL) return;
+    for (int i = 0; i < NUM_PERF_COUNTERS; i++) {
+        if (fds[i] != -1) ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+void perf_job_disable(size_t index) {
+    int *fds = perf_fds(index);
+    if (fds == NULL) return;
+    for (int i = 0; i < NUM_PERF_COUNTERS; i++) {
+        if (fds[i] != -1) ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+    }
+}
+
+void perf_job_close(size_t index) {
+    int64_t *counts = job_info(index)->perfCounts;
+    int *fds = perf_fds(index);
+    for (int i = 0; i < NUM_PERF_COUNTERS; i++) {
+        uint64_t value;
+        counts[i] = -1;
+        if (fds == NULL || fds[i] == -1) continue;
+        if (read(fds[i], &value, sizeof(value)) == sizeof(value)) counts[i] = (int64_t)value;
+        close(fds[i]);
+    }
+    if (fds != NULL) fds[0] = 0;
+}
+
+// Upper bound, in us, of the log2 bucket holding the given fraction of count durations
+static double phase_percentile_us(const uint32_t *histogram, uint64_t count, double fraction) {
+    uint64_t rank = (uint64_t)(count * fraction), seen = 0;
+    for (int bucket = 0; bucket < PHASE_BUCKETS; bucket++) {
+        seen += histogram[bucket];
+        if (seen > rank) return (double)(2ull << bucket) / 1e3;
+    }
+    return (double)(2ull << (PHASE_BUCKETS - 1)) / 1e3;
+}
+
+void print_instrument_report(void) {
+    const InstrumentBlock *block = &sharedData->instrument;
+    int slots = sharedData->NCPU;
+
+    printf("\nDispatch Phases (percentiles are log2 bucket bounds):\n");
+    printf("%-8s %10s %12s %10s %10s %10s\n", "Phase", "Calls", "Total ms", "Mean us", "p50 us", "p99 us");
+    for (int phase = 0; phase < NUM_PHASES; phase++) {
+        uint64_t count = block->loop.count[phase], totalNs = block->loop.totalNs[phase];
+        uint32_t histogram[PHASE_BUCKETS];
+        memcpy(histogram, block->loop.histogram[phase], sizeof(histogram));
+        for (int slot = 0; slot < slots; slot++) {
+            count += block->slots[slot].count[phase];
+            totalNs += block->slots[slot].totalNs[phase];
+            for (int bucket = 0; bucket < PHASE_BUCKETS; bucket++) {
+                histogram[bucket] += block->slots[slot].histogram[phase][bucket];
+            }
+        }
+        if (count == 0) continue;
+        printf("%-8s %10llu %12.2f %10.2f %10.2f %10.2f\n", phaseNames[phase], (unsigned long long)count,
+               totalNs / 1e6, totalNs / 1e3 / count, phase_percentile_us(histogram, count, 0.5),
+               phase_percentile_us(histogram, count, 0.99));
+    }
+
+    // What each slot's dispatching cost, waits aside
+    printf("Dispatch time per slot:");
+    for (int slot = -1; slot < slots; slot++) {
+        const SlotCounters *counters = slot >= 0 ? &block->slots[slot] : &block->loop;
+        uint64_t busyNs = 0;
+        for (int phase = 0; phase < NUM_PHASES; phase++) {
+            if (phase != PHASE_WAIT) busyNs += counters->totalNs[phase];
+        }
+        if (slot == -1) printf(" loop: %.3f ms", busyNs / 1e6);
+        else printf(" %d: %.3f ms", slot, busyNs / 1e6);
+    }
+    printf("\n");
+
+    if (!perfEventsEnabled) return;
+    printf("\nPer-job counters, resume to stop:\n");
+    printf("%-16s %-7s %16s %16s %16s\n", "Name", "PID", "Ctx switches", "Cycles", "Cache misses");
+    for (size_t i = 0; i < sharedData->jobCount; i++) {
+        if (job_states()[i] != JOB_DONE || job_pids()[i] <= 0) continue;
+        const int64_t *counts = job_info(i)->perfCounts;
+        printf("%-16s %-7d", job_info(i)->executableName, job_pids()[i]);
+        for (int c = 0; c < NUM_PERF_COUNTERS; c++) {
+            if (counts[c] >= 0) printf(" %16lld", (long long)counts[c]);
+            else printf(" %16s", "n/a");
+        }
+        printf("\n");
+    }
+}
+
+#endif // SCHED_INSTRUMENT
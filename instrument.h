@@ -0,0 +1,58 @@
+#ifndef INSTRUMENT_H
+#define INSTRUMENT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include "shared_memory.h"
+#include "scheduler.h"
+
+// Hot-path instrumentation of the dispatch loops, compiled in with
+// make INSTRUMENT=1 (-DSCHED_INSTRUMENT). Each phase of a loop iteration is
+// timed into the counters of the slot it ran for, in sharedData->instrument:
+// a call count, a total and a log2 latency histogram per phase. A slot's
+// counters have a cache line of their own and only that slot's dispatcher
+// writes them, so recording takes no lock or atomic. Built without
+// SCHED_INSTRUMENT, every macro below expands to nothing and the segment has
+// no instrument block.
+//
+// With perfEventsEnabled, each job also gets perf_event_open counters for
+// context switches, cycles and cache misses, enabled while it is resumed and
+// disabled when it is stopped, and read when it finishes.
+
+#ifdef SCHED_INSTRUMENT
+
+extern bool perfEventsEnabled;  // Set before start_scheduler(); needs perf_event_paranoid to allow it
+
+static inline void instrument_record(int slot, int phase, uint64_t ns) {
+    SlotCounters *counters = slot >= 0 ? &sharedData->instrument.slots[slot] : &sharedData->instrument.loop;
+    int bucket = 63 - __builtin_clzll(ns | 1);
+    counters->count[phase]++;
+    counters->totalNs[phase] += ns;
+    counters->histogram[phase][bucket < PHASE_BUCKETS ? bucket : PHASE_BUCKETS - 1]++;
+}
+
+#define INSTRUMENT_BEGIN(name) uint64_t name = now_ns()
+#define INSTRUMENT_END(name, slot, phase) instrument_record((slot), (phase), now_ns() - (name))
+
+// Make room for the counters of capacity jobs. Called while no other thread
+// uses the counters, so that launches never move them under a dispatcher.
+void perf_jobs_reserve(size_t capacity);
+// Open a launched job's counters, disabled
+void perf_job_open(size_t index);
+void perf_job_enable(size_t index);
+void perf_job_disable(size_t index);
+// Read a finished job's counters into its ProcessInfo and close them
+void perf_job_close(size_t index);
+
+// Print the phase table of the counters so far; safe from any process mapping the segment
+void print_instrument_report(void);
+
+#else
+
+#define INSTRUMENT_BEGIN(name) ((void)0)
+#define INSTRUMENT_END(name, slot, phase) ((void)0)
+
+#endif // SCHED_INSTRUMENT
+
+#endif // INSTRUMENT_H
@@ -0,0 +1,361 @@
+#define _GNU_SOURCE
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <libgen.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "journal.h"
+
+enum {
+    JOURNAL_SUBMIT = 1,       // Payload: SubmitRecord, then its argBytes of strings
+    JOURNAL_START,            // Payload: JournalStart
+    JOURNAL_EXIT              // No payload
+};
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+} JournalFileHeader;
+
+typedef struct {
+    uint32_t type;
+    uint32_t index;           // Job table index in the session that wrote the record
+    uint32_t length;          // Payload bytes following the header
+    uint32_t checksum;        // FNV-1a over type, index, length and the payload
+} JournalRecordHeader;
+
+typedef struct {
+    int32_t pid;
+    uint64_t startTicks;
+} JournalStart;
+
+static pthread_mutex_t journalLock = PTHREAD_MUTEX_INITIALIZER;  // Per-CPU dispatchers record exits concurrently
+static int journalFd = -1;
+static char journalPath[PATH_MAX];
+static char freshPath[PATH_MAX + 8];  // The journal being written until journal_install() renames it
+static char buffer[JOURNAL_BUFFER_SIZE];
+static size_t buffered;
+static int unsynced;                  // Records written since the last fdatasync
+static int batchDepth;
+static int commitPending;             // A commit was asked for inside the current batch
+
+static uint32_t fnv1a(uint32_t hash, const void *data, size_t size) {
+    for (const unsigned char *c = data; size-- > 0; c++) {
+        hash = (hash ^ *c) * 16777619u;
+    }
+    return hash;
+}
+
+static uint32_t record_checksum(const JournalRecordHeader *header, const void *payload, size_t length,
+                                const void *extra, size_t extraLength) {
+    uint32_t hash = fnv1a(2166136261u, header, offsetof(JournalRecordHeader, checksum));
+    hash = fnv1a(hash, payload, length);
+    return fnv1a(hash, extra, extraLength);
+}
+
+static int write_all(int fd, const void *data, size_t size) {
+    const char *next = data;
+    while (size > 0) {
+        ssize_t written = write(fd, next, size);
+        if (written == -1) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        next += written;
+        size -= written;
+    }
+    return 0;
+}
+
+// Caller holds journalLock
+static void flush_buffer(void) {
+    if (buffered == 0) return;
+    if (write_all(journalFd, buffer, buffered) == -1) perror("journal write");
+    buffered = 0;
+    unsynced = 1;
+}
+
+static void append_bytes(const void *data, size_t size) {
+    if (buffered + size > sizeof(buffer)) flush_buffer();
+    if (size > sizeof(buffer)) {
+        if (write_all(journalFd, data, size) == -1) perror("journal write");
+        unsynced = 1;
+        return;
+    }
+    memcpy(buffer + buffered, data, size);
+    buffered += size;
+}
+
+static void commit_locked(void) {
+    flush_buffer();
+    if (unsynced && fdatasync(journalFd) == -1) perror("journal fdatasync");
+    unsynced = 0;
+}
+
+// Append one record whose payload is payload followed by extra
+static void append_record(uint32_t type, size_t index, const void *payload, size_t length,
+                          const void *extra, size_t extraLength) {
+    JournalRecordHeader header = { type, (uint32_t)index, (uint32_t)(length + extraLength), 0 };
+    header.checksum = record_checksum(&header, payload, length, extra, extraLength);
+
+    pthread_mutex_lock(&journalLock);
+    if (journalFd != -1) {
+        append_bytes(&header, sizeof(header));
+        append_bytes(payload, length);
+        append_bytes(extra, extraLength);
+    }
+    pthread_mutex_unlock(&journalLock);
+}
+
+void journal_commit(void) {
+    pthread_mutex_lock(&journalLock);
+    if (journalFd != -1) {
+        if (batchDepth > 0) commitPending = 1;
+        else commit_locked();
+    }
+    pthread_mutex_unlock(&journalLock);
+}
+
+void journal_begin_batch(void) {
+    pthread_mutex_lock(&journalLock);
+    batchDepth++;
+    pthread_mutex_unlock(&journalLock);
+}
+
+void journal_end_batch(void) {
+    pthread_mutex_lock(&journalLock);
+    if (--batchDepth == 0 && commitPending) {
+        if (journalFd != -1) commit_locked();
+        commitPending = 0;
+    }
+    pthread_mutex_unlock(&journalLock);
+}
+
+void journal_submit(size_t index, const SubmitRecord *record, const char *block) {
+    SubmitRecord copy = *record;
+    copy.argOffset = 0;  // Arena positions mean nothing once the record is replayed
+    append_record(JOURNAL_SUBMIT, index, &copy, sizeof(copy), block, block != NULL ? record->argBytes : 0);
+    journal_commit();
+}
+
+void journal_start(size_t index, pid_t pid) {
+    if (journalFd == -1) return;  // Not journaling; spare the /proc read
+    JournalStart start = { pid, journal_process_start(pid) };
+    append_record(JOURNAL_START, index, &start, sizeof(start), NULL, 0);
+    journal_commit();
+}
+
+void journal_exit(size_t index) {
+    append_record(JOURNAL_EXIT, index, NULL, 0, NULL, 0);
+}
+
+uint64_t journal_process_start(pid_t pid) {
+    char path[64], text[1024];
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+    FILE *file = fopen(path, "r");
+    if (file == NULL) return 0;
+    size_t length = fread(text, 1, sizeof(text) - 1, file);
+    fclose(file);
+    text[length] = '\0';
+
+    // The command name may hold spaces and parentheses; the fields resume after its last ')'
+    char *fields = strrchr(text, ')');
+    char state;
+    unsigned long long startTicks;
+    if (fields == NULL || sscanf(fields + 1, " %c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %*u %*u %*d %*d %*d %*d %*d %*d %llu",
+                                 &state, &startTicks) != 2) {
+        return 0;
+    }
+    return state == 'Z' || state == 'X' ? 0 : startTicks;
+}
+
+// Replay state of one job table index of the journal's session
+typedef struct {
+    JournalJob job;
+    bool submitted;
+} ReplayEntry;
+
+static ReplayEntry *replay_entry(ReplayEntry **entries, size_t *capacity, size_t index) {
+    if (index >= *capacity) {
+        size_t grown = *capacity ? *capacity : 64;
+        while (grown <= index) grown *= 2;
+        ReplayEntry *larger = realloc(*entries, grown * sizeof(ReplayEntry));
+        if (larger == NULL) return NULL;
+        memset(larger + *capacity, 0, (grown - *capacity) * sizeof(ReplayEntry));
+        *entries = larger;
+        *capacity = grown;
+    }
+    return &(*entries)[index];
+}
+
+// Whether entry belongs in the recovered set: a job that has not exited, or
+// any stage of a gang that has not wholly exited. A gang whose records were
+// cut short never started and is dropped.
+static bool recoverable(const ReplayEntry *entries, size_t capacity, size_t index) {
+    const SubmitRecord *record = &entries[index].job.record;
+    if (record->gangSize <= 1) return !entries[index].job.exited;
+    if (record->gangStage > index) return false;
+
+    size_t leader = index - record->gangStage;
+    bool live = false;
+    for (size_t stage = leader; stage < leader + record->gangSize; stage++) {
+        if (stage >= capacity || !entries[stage].submitted) return false;
+        live |= !entries[stage].job.exited;
+    }
+    return live;
+}
+
+int journal_recover(const char *path, JournalJob **jobs, size_t *count) {
+    *jobs = NULL;
+    *count = 0;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        if (errno == ENOENT) return 0;
+        perror(path);
+        return -1;
+    }
+
+    struct stat info;
+    char *data = NULL;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) data = malloc(info.st_size);
+    ssize_t size = data != NULL ? read(fd, data, info.st_size) : 0;
+    close(fd);
+    if (size <= 0) {
+        free(data);
+        return 0;  // Empty: the last session finished every job
+    }
+
+    const JournalFileHeader *fileHeader = (const JournalFileHeader *)data;
+    if ((size_t)size < sizeof(*fileHeader) || fileHeader->magic != JOURNAL_MAGIC ||
+        fileHeader->version != JOURNAL_VERSION) {
+        fprintf(stderr, "%s is not a job journal; leaving it alone.\n", path);
+        free(data);
+        return -1;
+    }
+
+    ReplayEntry *entries = NULL;
+    size_t capacity = 0, highest = 0;
+    size_t offset = sizeof(*fileHeader);
+    while (offset + sizeof(JournalRecordHeader) <= (size_t)size) {
+        JournalRecordHeader header;
+        memcpy(&header, data + offset, sizeof(header));
+        const char *payload = data + offset + sizeof(header);
+        if (header.length > (size_t)size - offset - sizeof(header) ||
+            record_checksum(&header, payload, header.length, NULL, 0) != header.checksum) {
+            fprintf(stderr, "Journal %s ends in a torn record; replaying up to it.\n", path);
+            break;
+        }
+        offset += sizeof(header) + header.length;
+
+        ReplayEntry *entry = replay_entry(&entries, &capacity, header.index);
+        if (entry == NULL) {
+            perror("realloc");
+            break;
+        }
+        if (header.type == JOURNAL_SUBMIT && header.length >= sizeof(SubmitRecord)) {
+            memcpy(&entry->job.record, payload, sizeof(SubmitRecord));
+            uint32_t bytes = header.length - sizeof(SubmitRecord);
+            entry->job.record.argBytes = bytes;
+            if (bytes > 0 && (entry->job.block = malloc(bytes)) != NULL) {
+                memcpy(entry->job.block, payload + sizeof(SubmitRecord), bytes);
+            } else {
+                entry->job.record.argBytes = 0;
+            }
+            entry->submitted = true;
+            if (header.index + 1 > highest) highest = header.index + 1;
+        } else if (header.type == JOURNAL_START && header.length == sizeof(JournalStart)) {
+            JournalStart start;
+            memcpy(&start, payload, sizeof(start));
+            entry->job.pid = start.pid;
+            entry->job.startTicks = start.startTicks;
+        } else if (header.type == JOURNAL_EXIT) {
+            entry->job.exited = 1;
+        }
+    }
+    free(data);
+
+    JournalJob *result = malloc((highest ? highest : 1) * sizeof(JournalJob));
+    for (size_t i = 0; i < highest; i++) {
+        if (result != NULL && entries[i].submitted && recoverable(entries, capacity, i)) {
+            result[(*count)++] = entries[i].job;
+        } else {
+            free(entries[i].job.block);
+        }
+    }
+    free(entries);
+    if (result == NULL) {
+        perror("malloc");
+        return -1;
+    }
+    *jobs = result;
+    return 0;
+}
+
+void journal_free_jobs(JournalJob *jobs, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        free(jobs[i].block);
+    }
+    free(jobs);
+}
+
+int journal_open(const char *path) {
+    snprintf(journalPath, sizeof(journalPath), "%s", path);
+    snprintf(freshPath, sizeof(freshPath), "%s.new", path);
+    int fd = open(freshPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        perror(freshPath);
+        return -1;
+    }
+
+    pthread_mutex_lock(&journalLock);
+    journalFd = fd;
+    buffered = 0;
+    JournalFileHeader header = { JOURNAL_MAGIC, JOURNAL_VERSION };
+    append_bytes(&header, sizeof(header));
+    pthread_mutex_unlock(&journalLock);
+    return 0;
+}
+
+int journal_install(void) {
+    int result = 0;
+    pthread_mutex_lock(&journalLock);
+    if (journalFd != -1) {
+        commit_locked();
+        if (rename(freshPath, journalPath) == -1) {
+            perror(journalPath);
+            result = -1;
+        } else {
+            // Make the rename itself durable
+            char directory[PATH_MAX];
+            snprintf(directory, sizeof(directory), "%s", journalPath);
+            int dirFd = open(dirname(directory), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (dirFd != -1) {
+                fsync(dirFd);
+                close(dirFd);
+            }
+        }
+    }
+    pthread_mutex_unlock(&journalLock);
+    return result;
+}
+
+void journal_close(int unfinishedJobs) {
+    pthread_mutex_lock(&journalLock);
+    if (journalFd != -1) {
+        if (unfinishedJobs == 0) {
+            buffered = 0;
+            if (ftruncate(journalFd, 0) == -1) perror("journal ftruncate");
+            unsynced = 1;
+        }
+        commit_locked();
+        close(journalFd);
+        journalFd = -1;
+    }
+    pthread_mutex_unlock(&journalLock);
+}
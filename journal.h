@@ -0,0 +1,70 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include "shared_memory.h"
+
+// Append-only job journal, so that a scheduler that crashes can be restarted
+// without losing work. The scheduler records each job's submission (with its
+// arguments), its spawn (with its pid) and its exit. On the next start the
+// journal is replayed: jobs that never started are submitted again, jobs whose
+// stopped processes are still alive are re-adopted, and the journal is
+// rewritten holding only those jobs.
+//
+// Records are buffered and written with one fdatasync per commit. The
+// scheduler commits once per drained batch of submissions, before any of the
+// batch is resumed, so a job never runs without its spawn being on disk.
+// Exits ride along with the next commit: an exit lost in a crash only means
+// the job is found dead at recovery. Each record carries a checksum, and
+// replay stops at the first torn or corrupt one.
+
+#define JOURNAL_MAGIC 0x4c4e524au   // "JRNL"
+#define JOURNAL_VERSION 1
+#define JOURNAL_BUFFER_SIZE (64 * 1024)
+
+// A job replayed from the journal that had not exited
+typedef struct {
+    SubmitRecord record;      // As submitted; argOffset is 0, the strings are in block
+    char *block;              // record.argBytes bytes of packed strings, NULL for none
+    pid_t pid;                // The job's process, 0 if it never started
+    uint64_t startTicks;      // Start time of pid in /proc/<pid>/stat, to tell it from a reused pid
+    int exited;               // A gang stage that exited while other stages did not
+} JournalJob;
+
+// Replay the journal at path into *jobs, in submission order, gangs whole.
+// A missing file is not an error and yields no jobs. Returns -1 if the file
+// exists but is not a journal, in which case it must be left alone.
+int journal_recover(const char *path, JournalJob **jobs, size_t *count);
+
+// Free what journal_recover() returned
+void journal_free_jobs(JournalJob *jobs, size_t count);
+
+// Start a fresh journal beside path; records go to it from now on, and
+// journal_install() replaces path with it. Returns -1 if it cannot be created.
+int journal_open(const char *path);
+
+// Commit the fresh journal and atomically rename it over path, once the jobs
+// carried over from the old one have been recorded in it
+int journal_install(void);
+
+// Record events; job indices are those of the current job table
+void journal_submit(size_t index, const SubmitRecord *record, const char *block);
+void journal_start(size_t index, pid_t pid);
+void journal_exit(size_t index);
+
+// Make every record so far durable. Inside a batch the commit is deferred to
+// journal_end_batch(), so a batch costs one fdatasync however many jobs it has.
+void journal_commit(void);
+void journal_begin_batch(void);
+void journal_end_batch(void);
+
+// Commit and close. With no job left unfinished the journal is truncated, as
+// there is nothing to recover.
+void journal_close(int unfinishedJobs);
+
+// Start time of a live process from /proc/<pid>/stat, in clock ticks since
+// boot; 0 if there is no such process or it has already exited
+uint64_t journal_process_start(pid_t pid);
+
+#endif // JOURNAL_H
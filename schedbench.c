@@ -0,0 +1,565 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <sys/wait.h>
+#include "shared_memory.h"
+#include "scheduler.h"
+#include "burn.h"
+
+// Benchmark driver. Each run pushes a batch of identical jobs through the real
+// scheduler (process backend, forked so runs share no state) and reports
+// submit-to-dispatch and submit-to-first-run latency, per-slice dispatch
+// overhead and throughput, over a grid of NCPU, TSLICE and burst lengths.
+// A separate micro-benchmark measures how long a stopped process takes to
+// run again after SIGCONT. Results are one metric per CSV row or JSON object.
+
+SharedMemoryData *sharedData = NULL;
+size_t shared_size;
+
+void initialize_process_schedule();
+
+#define MAX_GRID 16
+
+// One result, sent from the run's child process to the driver through a pipe
+typedef struct {
+    char bench[16];           // "dispatch" or "sigcont"
+    char workload[16];
+    int ncpu;
+    int tsliceMs;
+    int burstMs;              // 0 where the workload has no configurable burst
+    char metric[32];
+    double value;
+    char unit[16];
+} BenchRow;
+
+typedef struct {
+    const char *name;
+    char path[MAX_NAME_LENGTH];
+    int hasBurst;             // Burst length is set through BURN_MS
+} Workload;
+
+static Workload workloads[] = {
+    { "burn", "", 1 },
+    { "fib", "", 0 },
+    { "helloworld", "", 0 },
+};
+#define NUM_WORKLOADS (int)(sizeof(workloads) / sizeof(workloads[0]))
+
+static int rowsOut;           // Where a run's child writes its rows
+static int jsonOutput;
+static int rowsPrinted;
+
+// Copy a row's string into its field; returns -1, with a message, if it does not fit
+static int set_field(char *field, size_t size, const char *value) {
+    if ((size_t)snprintf(field, size, "%s", value) < size) return 0;
+    fprintf(stderr, "schedbench: '%s' does not fit in a %zu-byte result field; row dropped.\n", value, size);
+    return -1;
+}
+
+static void emit(const char *bench, const char *workload, int ncpu, int tsliceMs, int burstMs,
+                 const char *metric, double value, const char *unit) {
+    BenchRow row = { .ncpu = ncpu, .tsliceMs = tsliceMs, .burstMs = burstMs, .value = value };
+    // A truncated name or unit would go unnoticed in the CSV or JSON, so the row is dropped instead
+    if (set_field(row.bench, sizeof(row.bench), bench) == -1 ||
+        set_field(row.workload, sizeof(row.workload), workload) == -1 ||
+        set_field(row.metric, sizeof(row.metric), metric) == -1 ||
+        set_field(row.unit, sizeof(row.unit), unit) == -1) {
+        return;
+    }
+    if (write(rowsOut, &row, sizeof(row)) != sizeof(row)) {
+        perror("write");
+    }
+}
+
+static void print_row(const BenchRow *row) {
+    if (jsonOutput) {
+        printf("%s\n  {\"bench\": \"%s\", \"workload\": \"%s\", \"ncpu\": %d, \"tslice_ms\": %d, \"burst_ms\": %d, "
+               "\"metric\": \"%s\", \"value\": %.6f, \"unit\": \"%s\"}",
+               rowsPrinted ? "," : "", row->bench, row->workload, row->ncpu, row->tsliceMs, row->burstMs,
+               row->metric, row->value, row->unit);
+    } else {
+        printf("%s,%s,%d,%d,%d,%s,%.6f,%s\n", row->bench, row->workload, row->ncpu, row->tsliceMs,
+               row->burstMs, row->metric, row->value, row->unit);
+    }
+    rowsPrinted++;
+    fflush(stdout);
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of an ascending array
+static double percentile(const double *sorted, size_t count, int p) {
+    size_t rank = (p * count + 99) / 100;
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+static void emit_percentiles(const char *bench, const Workload *workload, int ncpu, int tsliceMs, int burstMs,
+                             const char *metric, double *values, size_t count, const char *unit) {
+    static const int ranks[] = { 50, 95, 99 };
+    char name[32];
+    if (count == 0) return;
+    qsort(values, count, sizeof(double), compare_doubles);
+    for (int r = 0; r < 3; r++) {
+        snprintf(name, sizeof(name), "%s_p%d", metric, ranks[r]);
+        emit(bench, workload->name, ncpu, tsliceMs, burstMs, name, percentile(values, count, ranks[r]), unit);
+    }
+}
+
+// Submission side of a dispatch run: jobs not yet published fit the ring as it drains
+static const Workload *benchWorkload;
+static int jobsToSubmit;
+
+static void publish_jobs(void) {
+    SubmitRing *ring = &sharedData->submitRing;
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+    for (; jobsToSubmit > 0 && tail - head < SUBMIT_RING_SIZE; jobsToSubmit--) {
+        SubmitRecord *record = &ring->records[tail & (SUBMIT_RING_SIZE - 1)];
+        snprintf(record->executableName, sizeof(record->executableName), "%s", benchWorkload->name);
+        strcpy(record->executablePath, benchWorkload->path);
+        record->priority = MIN_PRIORITY;
+        record->arrivalNs = now_ns();
+        record->argBytes = 0;  // Spawned with no arguments
+        record->gangSize = 0;
+        record->deadlineMs = 0;
+        tail++;
+    }
+    atomic_store_explicit(&ring->tail, tail, memory_order_release);
+}
+
+// Keeps the scheduler running, and publishing, until every job is submitted
+static uint64_t bench_next_arrival(void) {
+    publish_jobs();
+    return jobsToSubmit > 0 ? now_ns() : UINT64_MAX;
+}
+
+// Run jobCount jobs of one workload through the scheduler and report on them.
+// Runs in a child process; the scheduler's output goes to /dev/null.
+static void run_dispatch(const Workload *workload, int jobCount, int ncpu, int tsliceMs, int burstMs,
+                         DispatchMode dispatchMode, SchedPolicy policy, SliceMode sliceMode, int useCgroups) {
+    int devNull = open("/dev/null", O_WRONLY);
+    if (devNull != -1) dup2(devNull, STDOUT_FILENO);
+
+    // Started and resumed burn jobs append their timestamps here
+    char reportPath[] = "/tmp/schedbench-XXXXXX";
+    int reportFd = mkstemp(reportPath);
+    if (reportFd == -1) {
+        perror("mkstemp");
+        exit(1);
+    }
+    unlink(reportPath);
+    fcntl(reportFd, F_SETFL, O_APPEND);
+
+    char value[32];
+    snprintf(value, sizeof(value), "%d", reportFd);
+    setenv(BURN_REPORT_FD_ENV, value, 1);
+    snprintf(value, sizeof(value), "%d", burstMs);
+    setenv(BURN_MS_ENV, value, 1);
+
+    init_private_memory(&sharedData, &shared_size);
+    check_shared_layout(sharedData);
+    sharedData->NCPU = ncpu;
+    sharedData->TSLICE = tsliceMs;
+    sharedData->dispatchMode = dispatchMode;
+    sharedData->policy = policy;
+    sharedData->sliceMode = sliceMode;
+    sharedData->affinityEnabled = false;
+    initialize_process_schedule();
+
+    if (useCgroups) cgroup_backend_init();
+    static SchedBackend benchBackend;
+    benchBackend = *schedBackend;
+    benchBackend.next_arrival = bench_next_arrival;
+    schedBackend = &benchBackend;
+    verbosity = LOG_QUIET;
+
+    benchWorkload = workload;
+    jobsToSubmit = jobCount;
+    publish_jobs();
+    start_scheduler(sharedData, shared_size, ncpu, tsliceMs);
+    cgroup_backend_release();
+
+    size_t count = sharedData->jobCount;
+    double *dispatch = malloc(count * sizeof(double));
+    double *firstRun = malloc(count * sizeof(double));
+    if (dispatch == NULL || firstRun == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+
+    uint64_t firstArrival = UINT64_MAX, lastEnd = 0, spawnNs = 0;
+    size_t completed = 0;
+    for (size_t i = 0; i < count; i++) {
+        ProcessInfo *process = job_info(i);
+        if (process->arrival_time < firstArrival) firstArrival = process->arrival_time;
+        if (process->end_time > lastEnd) lastEnd = process->end_time;
+        spawnNs += process->spawnNs;
+        completed += process->end_time != 0;
+        dispatch[i] = process->start_time != 0 ? (process->start_time - process->arrival_time) / 1e6 : 0;
+    }
+
+    // A job first runs when its main() starts, which only burn reports
+    size_t firstRuns = 0;
+    BurnRecord record;
+    lseek(reportFd, 0, SEEK_SET);
+    while (read(reportFd, &record, sizeof(record)) == sizeof(record)) {
+        if (record.event != BURN_STARTED) continue;
+        size_t index = pid_index_lookup(record.pid);
+        if (index == (size_t)-1 || record.ns < job_info(index)->arrival_time) continue;
+        firstRun[firstRuns++] = (record.ns - job_info(index)->arrival_time) / 1e6;
+    }
+
+    const char *name = workload->name;
+    double makespanMs = lastEnd > firstArrival ? (lastEnd - firstArrival) / 1e6 : 0;
+    uint64_t slices = sharedData->slicesStarted;
+    uint64_t overheadNs = sharedData->dispatchNs > spawnNs ? sharedData->dispatchNs - spawnNs : 0;
+
+    emit("dispatch", name, ncpu, tsliceMs, burstMs, "jobs_completed", completed, "jobs");
+    emit("dispatch", name, ncpu, tsliceMs, burstMs, "makespan", makespanMs, "ms");
+    emit("dispatch", name, ncpu, tsliceMs, burstMs, "throughput", makespanMs > 0 ? completed / (makespanMs / 1e3) : 0, "jobs/s");
+    emit("dispatch", name, ncpu, tsliceMs, burstMs, "slices", slices, "slices");
+    emit("dispatch", name, ncpu, tsliceMs, burstMs, "dispatch_rate", makespanMs > 0 ? slices / (makespanMs / 1e3) : 0, "slices/s");
+    emit("dispatch", name, ncpu, tsliceMs, burstMs, "slice_overhead", slices ? overheadNs / 1e3 / slices : 0, "us");
+    emit("dispatch", name, ncpu, tsliceMs, burstMs, "spawn_mean", count ? spawnNs / 1e6 / count : 0, "ms");
+    emit_percentiles("dispatch", workload, ncpu, tsliceMs, burstMs, "submit_to_dispatch", dispatch, count, "ms");
+    emit_percentiles("dispatch", workload, ncpu, tsliceMs, burstMs, "submit_to_first_run", firstRun, firstRuns, "ms");
+
+    if (completed != count) {
+        fprintf(stderr, "%s ncpu=%d tslice=%d: only %zu of %zu jobs completed\n", name, ncpu, tsliceMs, completed, count);
+    }
+}
+
+// Stop and continue one burn process repeatedly, timing each SIGCONT until its
+// handler runs. This is the floor under every resume the dispatcher issues.
+static void run_sigcont(const Workload *workload, int iterations) {
+    int fds[2];
+    if (pipe(fds) == -1) {
+        perror("pipe");
+        exit(1);
+    }
+
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("fork");
+        exit(1);
+    }
+    if (pid == 0) {
+        char value[32];
+        close(fds[0]);
+        snprintf(value, sizeof(value), "%d", fds[1]);
+        setenv(BURN_REPORT_FD_ENV, value, 1);
+        setenv(BURN_MS_ENV, "3600000", 1);  // Outlives the benchmark, which kills it
+        execl(workload->path, workload->name, (char *)NULL);
+        perror(workload->path);
+        _exit(127);
+    }
+    close(fds[1]);
+
+    BurnRecord record;
+    double *latency = malloc(iterations * sizeof(double));
+    int samples = 0;
+    if (latency == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+
+    // Wait for the started record, so the SIGCONT handler is installed
+    if (read(fds[0], &record, sizeof(record)) == sizeof(record)) {
+        for (int i = 0; i < iterations; i++) {
+            int status;
+            kill(pid, SIGSTOP);
+            if (waitpid(pid, &status, WUNTRACED) != pid || !WIFSTOPPED(status)) break;
+
+            uint64_t sent = now_ns();
+            kill(pid, SIGCONT);
+            if (read(fds[0], &record, sizeof(record)) != sizeof(record)) break;
+            latency[samples++] = (record.ns - sent) / 1e3;
+        }
+    }
+    kill(pid, SIGKILL);
+    waitpid(pid, NULL, 0);
+    close(fds[0]);
+
+    if (samples < iterations) {
+        fprintf(stderr, "SIGCONT benchmark stopped after %d of %d iterations\n", samples, iterations);
+    }
+    emit_percentiles("sigcont", workload, 0, 0, 0, "sigcont_to_running", latency, samples, "us");
+    free(latency);
+}
+
+// Run one benchmark in a child process and print the rows it reports
+static void run_in_child(void (*body)(void *), void *arg) {
+    int fds[2];
+    if (pipe(fds) == -1) {
+        perror("pipe");
+        exit(1);
+    }
+
+    fflush(stdout);  // Or the child would print our buffered output again
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("fork");
+        exit(1);
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        rowsOut = fds[1];
+        body(arg);
+        exit(0);
+    }
+    close(fds[1]);
+
+    BenchRow row;
+    while (read(fds[0], &row, sizeof(row)) == sizeof(row)) {
+        print_row(&row);
+    }
+    close(fds[0]);
+
+    int status;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "Benchmark run failed\n");
+    }
+}
+
+typedef struct {
+    const Workload *workload;
+    int jobs, ncpu, tsliceMs, burstMs;
+    DispatchMode dispatchMode;
+    SchedPolicy policy;
+    SliceMode sliceMode;
+    int useCgroups;
+    int iterations;
+} RunConfig;
+
+static void dispatch_body(void *arg) {
+    RunConfig *config = arg;
+    run_dispatch(config->workload, config->jobs, config->ncpu, config->tsliceMs, config->burstMs,
+                 config->dispatchMode, config->policy, config->sliceMode,
+                 config->useCgroups);
+}
+
+static void sigcont_body(void *arg) {
+    RunConfig *config = arg;
+    run_sigcont(config->workload, config->iterations);
+}
+
+// Parse a comma-separated list of positive integers; returns the count, or -1 if malformed
+static int parse_list(const char *text, int *values, int max) {
+    int count = 0;
+    char *copy = strdup(text);
+    for (char *item = strtok(copy, ","); item != NULL; item = strtok(NULL, ",")) {
+        int value = atoi(item);
+        if (value <= 0 || count == max) {
+            free(copy);
+            return -1;
+        }
+        values[count++] = value;
+    }
+    free(copy);
+    return count;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [--ncpu=1,2,4] [--tslice=10,50] [--burst=5,20] [--jobs=N]\n"
+                    "          [--workloads=burn,fib,helloworld] [--dispatch=event|parallel|serial|percpu]\n"
+                    "          [--policy=rr|mlfq|srtf|edf|stride] [--slice=fixed|adaptive] [--backend=signal|cgroup]\n"
+                    "          [--sigcont=iterations] [--format=csv|json]\n", prog);
+}
+
+int main(int argc, char *argv[]) {
+    int ncpus[MAX_GRID] = { 1, 2, 4 }, ncpuCount = 3;
+    int tslices[MAX_GRID] = { 10, 50 }, tsliceCount = 2;
+    int bursts[MAX_GRID] = { 5, 20 }, burstCount = 2;
+    int jobs = 16;
+    int iterations = 1000;
+    int enabled[NUM_WORKLOADS] = { 1, 1, 1 };
+    DispatchMode dispatchMode = DISPATCH_EVENT;
+    SchedPolicy policy = POLICY_RR;
+    SliceMode sliceMode = SLICE_FIXED;
+    int useCgroups = 0;
+    static struct option long_options[] = {
+        {"ncpu", required_argument, NULL, 'n'},
+        {"tslice", required_argument, NULL, 't'},
+        {"burst", required_argument, NULL, 'b'},
+        {"jobs", required_argument, NULL, 'j'},
+        {"workloads", required_argument, NULL, 'w'},
+        {"dispatch", required_argument, NULL, 'd'},
+        {"policy", required_argument, NULL, 'p'},
+        {"slice", required_argument, NULL, 'l'},
+        {"backend", required_argument, NULL, 'k'},
+        {"sigcont", required_argument, NULL, 's'},
+        {"format", required_argument, NULL, 'f'},
+        {NULL, 0, NULL, 0}
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "n:t:b:j:w:d:p:l:k:s:f:", long_options, NULL)) != -1) {
+        switch (opt) {
+        case 'n':
+            ncpuCount = parse_list(optarg, ncpus, MAX_GRID);
+            break;
+        case 't':
+            tsliceCount = parse_list(optarg, tslices, MAX_GRID);
+            break;
+        case 'b':
+            burstCount = parse_list(optarg, bursts, MAX_GRID);
+            break;
+        case 'j':
+            jobs = atoi(optarg);
+            break;
+        case 'w':
+            for (int w = 0; w < NUM_WORKLOADS; w++) {
+                enabled[w] = 0;
+            }
+            for (char *item = strtok(optarg, ","); item != NULL; item = strtok(NULL, ",")) {
+                int w = 0;
+                while (w < NUM_WORKLOADS && strcmp(item, workloads[w].name) != 0) w++;
+                if (w == NUM_WORKLOADS) {
+                    fprintf(stderr, "Error: unknown workload '%s' (expected burn, fib or helloworld).\n", item);
+                    return EXIT_FAILURE;
+                }
+                enabled[w] = 1;
+            }
+            break;
+        case 'd':
+            if (strcmp(optarg, "event") == 0) {
+                dispatchMode = DISPATCH_EVENT;
+            } else if (strcmp(optarg, "parallel") == 0) {
+                dispatchMode = DISPATCH_PARALLEL;
+            } else if (strcmp(optarg, "serial") == 0) {
+                dispatchMode = DISPATCH_SERIAL;
+            } else if (strcmp(optarg, "percpu") == 0) {
+                dispatchMode = DISPATCH_PERCPU;
+            } else {
+                fprintf(stderr, "Error: unknown dispatch mode '%s' (expected event, parallel, serial or percpu).\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'p':
+            if (strcmp(optarg, "rr") == 0) {
+                policy = POLICY_RR;
+            } else if (strcmp(optarg, "mlfq") == 0) {
+                policy = POLICY_MLFQ;
+            } else if (strcmp(optarg, "srtf") == 0) {
+                policy = POLICY_SRTF;
+            } else if (strcmp(optarg, "edf") == 0) {
+                policy = POLICY_EDF;
+            } else if (strcmp(optarg, "stride") == 0) {
+                policy = POLICY_STRIDE;
+            } else {
+                fprintf(stderr, "Error: unknown policy '%s' (expected rr, mlfq, srtf, edf or stride).\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'l':
+            if (strcmp(optarg, "fixed") == 0) {
+                sliceMode = SLICE_FIXED;
+            } else if (strcmp(optarg, "adaptive") == 0) {
+                sliceMode = SLICE_ADAPTIVE;
+            } else {
+                fprintf(stderr, "Error: unknown slice mode '%s' (expected fixed or adaptive).\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'k':
+            if (strcmp(optarg, "signal") == 0) {
+                useCgroups = 0;
+            } else if (strcmp(optarg, "cgroup") == 0) {
+                useCgroups = 1;
+            } else {
+                fprintf(stderr, "Error: unknown backend '%s' (expected signal or cgroup).\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 's':
+            iterations = atoi(optarg);
+            break;
+        case 'f':
+            if (strcmp(optarg, "csv") == 0) {
+                jsonOutput = 0;
+            } else if (strcmp(optarg, "json") == 0) {
+                jsonOutput = 1;
+            } else {
+                fprintf(stderr, "Error: unknown format '%s' (expected csv or json).\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (optind != argc || ncpuCount <= 0 || tsliceCount <= 0 || burstCount <= 0 || jobs <= 0 || iterations < 0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (dispatchMode == DISPATCH_PERCPU && policy != POLICY_RR) {
+        fprintf(stderr, "Error: per-CPU dispatch runs round robin only; use --policy=rr.\n");
+        return EXIT_FAILURE;
+    }
+    for (int i = 0; i < ncpuCount; i++) {
+        if (ncpus[i] > MAX_NCPU) {
+            fprintf(stderr, "Error: ncpu must not exceed %d.\n", MAX_NCPU);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // The workloads are built next to the driver by `make bench`
+    for (int w = 0; w < NUM_WORKLOADS; w++) {
+        char relative[PATH_MAX], resolved[PATH_MAX];
+        if (!enabled[w]) continue;
+        snprintf(relative, sizeof(relative), "./%s", workloads[w].name);
+        if (realpath(relative, resolved) == NULL) {
+            perror(relative);
+            return EXIT_FAILURE;
+        }
+        if (strlen(resolved) >= MAX_NAME_LENGTH) {
+            fprintf(stderr, "Error: path of %s is longer than %d characters.\n", relative, MAX_NAME_LENGTH - 1);
+            return EXIT_FAILURE;
+        }
+        memcpy(workloads[w].path, resolved, strlen(resolved) + 1);
+    }
+
+    if (jsonOutput) {
+        printf("[");
+    } else {
+        printf("bench,workload,ncpu,tslice_ms,burst_ms,metric,value,unit\n");
+    }
+
+    RunConfig config = { .jobs = jobs, .dispatchMode = dispatchMode, .policy = policy,
+                         .sliceMode = sliceMode, .useCgroups = useCgroups, .iterations = iterations };
+    if (enabled[0] && iterations > 0) {
+        config.workload = &workloads[0];
+        run_in_child(sigcont_body, &config);
+    }
+
+    for (int w = 0; w < NUM_WORKLOADS; w++) {
+        if (!enabled[w]) continue;
+        config.workload = &workloads[w];
+        for (int n = 0; n < ncpuCount; n++) {
+            for (int t = 0; t < tsliceCount; t++) {
+                for (int b = 0; b < (workloads[w].hasBurst ? burstCount : 1); b++) {
+                    config.ncpu = ncpus[n];
+                    config.tsliceMs = tslices[t];
+                    config.burstMs = workloads[w].hasBurst ? bursts[b] : 0;
+                    run_in_child(dispatch_body, &config);
+                }
+            }
+        }
+    }
+
+    if (jsonOutput) printf("\n]\n");
+    return 0;
+}
@@ -1,9 +1,83 @@
 #ifndef SCHEDULER_H
 #define SCHEDULER_H
 
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/resource.h>
 #include "shared_memory.h"
 
-// Function to start the scheduler
+// All scheduler timestamps are CLOCK_MONOTONIC nanoseconds
+static inline uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// How the scheduler creates, runs and observes jobs. The process backend drives
+// real children with signals on the monotonic clock; the simulator (sim.c)
+// plugs in a virtual clock and synthetic jobs, so both run the same policies.
+typedef struct {
+    uint64_t (*now)(void);                    // Current time in ns
+    uint64_t (*next_arrival)(void);           // When the next not yet submitted job arrives, UINT64_MAX if none
+    int (*launch)(size_t index);              // Create the job stopped; -1 if it could not be created
+    void (*resume)(size_t index);             // Let a job run
+    void (*stop)(size_t index);               // Stop a running job
+    int (*reap)(size_t index, int *status, struct rusage *usage); // 1 and wait4-style results if the job exited
+    uint64_t (*cpu_time)(size_t index);       // CPU time a launched job has used so far, UINT64_MAX if unknown
+    void (*sleep_until)(uint64_t deadline);   // Let running jobs run until deadline
+    void (*open_events)(void);                // Set up for wait_event, before event-driven dispatch
+    void (*watch)(int slot, size_t index);    // Report exits of the job now on slot through wait_event
+    void (*unwatch)(int slot);
+    void (*wait_event)(uint64_t deadline);    // Return at deadline or earlier, once a watched job exits
+    void (*close_events)(void);
+} SchedBackend;
+
+extern const SchedBackend processBackend;
+extern const SchedBackend *schedBackend;    // Backend start_scheduler() uses, processBackend by default
+
+// Switch schedBackend to the cgroup v2 backend (cgroup.c): each job runs in its
+// own leaf cgroup, frozen and thawed instead of signalled. Returns -1, leaving
+// the signal backend in place, when cgroup v2 is missing or not writable.
+int cgroup_backend_init(void);
+
+// Remove the scheduler's cgroups; call once the scheduler is done
+void cgroup_backend_release(void);
+
+// Make room to track capacity jobs. Called while no job is being resumed or
+// stopped, so that launches never move the tracking under a dispatcher.
+void cgroup_reserve(size_t capacity);
+
+// Replace a reaped job's wait4() usage with its cgroup's CPU time and memory peak,
+// which cover every process the job started. Does nothing for jobs not in a cgroup.
+void cgroup_collect(size_t index, struct rusage *usage);
+
+// How much start_scheduler() prints while it runs
+enum {
+    LOG_QUIET = 0,            // Errors only
+    LOG_SUMMARY,              // Start and end of each run (default)
+    LOG_JOBS                  // Also every spawn, requeue, preemption and exit
+};
+
+extern int verbosity;                         // One of LOG_*
+#define log_at(level, ...) do { if (verbosity >= (level)) printf(__VA_ARGS__); } while (0)
+
+extern int schedulerWakeFd;                   // Continuous mode's eventfd, -1 to return once every job has finished
+extern const char *burstHistoryPath;          // File SRTF loads and saves burst predictions in, NULL to keep them in memory
+extern const char *journalPath;               // Crash recovery journal (journal.c), NULL for none
+
+// Print the scheduler's live statistics from a consistent snapshot of
+// sharedData->liveStats; safe to call from any process while it runs
+void print_live_stats(void);
+
+// Write the trace ring as Chrome trace / Perfetto JSON (trace.c): one track per
+// CPU slot with a span per slice, plus a track for spawns. Returns -1 on failure.
+int trace_export_chrome(const char *path);
+
+// Run the scheduler until every submitted job has finished. In continuous mode
+// (schedulerWakeFd set) it instead waits for more submissions whenever it is
+// idle, woken by a write to the eventfd, and returns only once the shell sets
+// stopRequested and the jobs submitted so far have finished.
 void start_scheduler(SharedMemoryData *data, size_t size,int ncpu,int tslice);
 
 #endif // SCHEDULER_H
\ No newline at end of file
@@ -0,0 +1,287 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "shared_memory.h"
+#include "scheduler.h"
+
+// Bytes each region needs per job table entry
+static const size_t regionEntrySize[NUM_REGIONS] = {
+    [REGION_PID] = sizeof(pid_t),
+    [REGION_STATE] = sizeof(uint8_t),
+    [REGION_PRIORITY] = sizeof(int8_t),
+    [REGION_LEVEL] = sizeof(int8_t),
+    [REGION_LAST_SLOT] = sizeof(int16_t),
+    [REGION_REMAINING] = sizeof(int32_t),
+    [REGION_KEY] = sizeof(uint64_t),
+    [REGION_INFO] = sizeof(ProcessInfo),
+    [REGION_READY] = NUM_PRIORITIES * sizeof(uint32_t),
+    [REGION_HEAP] = sizeof(uint32_t),
+    [REGION_PID_INDEX] = 2 * sizeof(PidIndexEntry),
+};
+
+// Byte offsets of every region for a job table of a given capacity
+typedef struct {
+    size_t offset[NUM_REGIONS];
+    size_t total;
+} ShmLayout;
+
+static size_t align_cache_line(size_t offset) {
+    return (offset + 63) & ~(size_t)63;
+}
+
+static ShmLayout layout_for(size_t capacity) {
+    ShmLayout layout;
+    size_t offset = sizeof(SharedMemoryData);
+    for (int r = 0; r < NUM_REGIONS; r++) {
+        layout.offset[r] = align_cache_line(offset);
+        offset = layout.offset[r] + capacity * regionEntrySize[r];
+    }
+    layout.total = offset;
+    return layout;
+}
+
+static void apply_layout_to(SharedMemoryData *data, size_t capacity, const ShmLayout *layout) {
+    data->jobCapacity = capacity;
+    memcpy(data->regionOffset, layout->offset, sizeof(layout->offset));
+    data->segmentSize = layout->total;
+}
+
+static void apply_layout(size_t capacity, const ShmLayout *layout) {
+    apply_layout_to(sharedData, capacity, layout);
+}
+
+// Descriptor of the segment this process created; kept open so it can be grown
+static int segmentFd = -1;
+
+// Size a fresh segment for INITIAL_JOB_CAPACITY jobs and map it
+static void map_new_segment(int fd, SharedMemoryData **sharedData, size_t *shared_size) {
+    // Truncate to zero first so nothing from a previous run survives
+    ShmLayout layout = layout_for(INITIAL_JOB_CAPACITY);
+    if (ftruncate(fd, 0) == -1 || ftruncate(fd, layout.total) == -1) {
+        perror("ftruncate");
+        close(fd);
+        exit(1);
+    }
+
+    *sharedData = mmap(NULL, layout.total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (*sharedData == MAP_FAILED) {
+        perror("mmap");
+        close(fd);
+        exit(1);
+    }
+    *shared_size = layout.total;
+    segmentFd = fd;
+
+    (*sharedData)->magic = SHM_MAGIC;
+    (*sharedData)->layoutVersion = SHM_LAYOUT_VERSION;
+    apply_layout(INITIAL_JOB_CAPACITY, &layout);
+}
+
+void init_shared_memory(SharedMemoryData **sharedData, size_t *shared_size) {
+    int shm_fd = shm_open(SHARED_MEM_NAME, O_CREAT | O_RDWR, 0666);
+    if (shm_fd == -1) {
+        perror("shm_open");
+        exit(1);
+    }
+    map_new_segment(shm_fd, sharedData, shared_size);
+}
+
+void init_private_memory(SharedMemoryData **sharedData, size_t *shared_size) {
+    int fd = memfd_create("simplescheduler", MFD_CLOEXEC);
+    if (fd == -1) {
+        perror("memfd_create");
+        exit(1);
+    }
+    map_new_segment(fd, sharedData, shared_size);
+}
+
+int grow_job_table(size_t minCapacity) {
+    size_t oldCapacity = sharedData->jobCapacity;
+    if (minCapacity <= oldCapacity) return 0;
+
+    size_t newCapacity = oldCapacity;
+    while (newCapacity < minCapacity) newCapacity *= 2;
+    ShmLayout oldLayout = layout_for(oldCapacity);
+    ShmLayout newLayout = layout_for(newCapacity);
+
+    // Ring storage is re-laid out for the new capacity, so save each ring in queue order
+    uint32_t *saved = malloc(NUM_PRIORITIES * oldCapacity * sizeof(uint32_t));
+    if (saved == NULL) {
+        perror("malloc");
+        return -1;
+    }
+    for (int level = 0; level < NUM_PRIORITIES; level++) {
+        ReadyRing *ring = &sharedData->readyQueue.rings[level];
+        for (uint32_t k = 0; k < ring->count; k++) {
+            saved[level * oldCapacity + k] = ready_slots(level)[(ring->head + k) % oldCapacity];
+        }
+    }
+
+    if (ftruncate(segmentFd, newLayout.total) == -1) {
+        perror("Growing shared memory failed");
+        free(saved);
+        return -1;
+    }
+
+    void *mapped = mremap(sharedData, shared_size, newLayout.total, MREMAP_MAYMOVE);
+    if (mapped == MAP_FAILED) {
+        perror("mremap");
+        free(saved);
+        return -1;
+    }
+    sharedData = mapped;
+
+    // Readers copying the table retry until layoutSeq is even and unchanged
+    atomic_fetch_add_explicit(&sharedData->layoutSeq, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    shared_size = newLayout.total;
+
+    // Every region only moves up, so sliding them from the last one down never
+    // overwrites a region that has not moved yet. Space past the old entries is cleared.
+    char *base = (char *)sharedData;
+    for (int r = NUM_REGIONS - 1; r >= 0; r--) {
+        size_t used = (r == REGION_READY || r == REGION_PID_INDEX) ? 0 : oldCapacity * regionEntrySize[r];
+        size_t end = r == NUM_REGIONS - 1 ? newLayout.total : newLayout.offset[r + 1];
+        memmove(base + newLayout.offset[r], base + oldLayout.offset[r], used);
+        memset(base + newLayout.offset[r] + used, 0, end - newLayout.offset[r] - used);
+    }
+    apply_layout(newCapacity, &newLayout);
+
+    for (int level = 0; level < NUM_PRIORITIES; level++) {
+        ReadyRing *ring = &sharedData->readyQueue.rings[level];
+        memcpy(ready_slots(level), &saved[level * oldCapacity], ring->count * sizeof(uint32_t));
+        ring->head = 0;
+        ring->tail = ring->count % newCapacity;
+    }
+    free(saved);
+
+    // The pid index is sized from the capacity, so rebuild it from the pid array
+    for (size_t i = 0; i < sharedData->jobCount; i++) {
+        if (job_pids()[i] > 0) pid_index_insert(job_pids()[i], i);
+    }
+    atomic_fetch_add_explicit(&sharedData->layoutSeq, 1, memory_order_release);
+
+    log_at(LOG_JOBS, "Job table grown to %zu entries (%zu bytes of shared memory).\n", newCapacity, newLayout.total);
+    return 0;
+}
+
+// The pid index is an open-addressing table with linear probing. It has two
+// buckets per job entry, so it is never more than half full. Entries are never
+// removed: a reaped job keeps its bucket, and a recycled pid overwrites it.
+static size_t pid_bucket(pid_t pid) {
+    size_t buckets = 2 * sharedData->jobCapacity;  // Capacity is a power of two
+    return ((uint32_t)pid * 2654435761u) & (buckets - 1);
+}
+
+void pid_index_insert(pid_t pid, size_t index) {
+    PidIndexEntry *table = job_region(REGION_PID_INDEX);
+    size_t mask = 2 * sharedData->jobCapacity - 1;
+    size_t bucket = pid_bucket(pid);
+    while (table[bucket].pid != 0 && table[bucket].pid != pid) {
+        bucket = (bucket + 1) & mask;
+    }
+    table[bucket].pid = pid;
+    table[bucket].index = (uint32_t)index;
+}
+
+size_t pid_index_lookup(pid_t pid) {
+    PidIndexEntry *table = job_region(REGION_PID_INDEX);
+    size_t mask = 2 * sharedData->jobCapacity - 1;
+    for (size_t bucket = pid_bucket(pid); table[bucket].pid != 0; bucket = (bucket + 1) & mask) {
+        if (table[bucket].pid == pid) return table[bucket].index;
+    }
+    return (size_t)-1;
+}
+
+void sync_shared_memory(void) {
+    size_t size = sharedData->segmentSize;
+    if (size == shared_size) return;
+
+    void *mapped = mremap(sharedData, shared_size, size, MREMAP_MAYMOVE);
+    if (mapped == MAP_FAILED) {
+        perror("mremap");
+        return;
+    }
+    sharedData = mapped;
+    shared_size = size;
+}
+
+// The live mapping while sharedData points at a snapshot
+static SharedMemoryData *liveData;
+static size_t liveSize;
+
+// Copy the table into a private buffer with the segment's layout. Returns
+// NULL if the layout changed under the copy, or with errno set if there is
+// no memory.
+static SharedMemoryData *copy_job_table(void) {
+    uint32_t seq = atomic_load_explicit(&sharedData->layoutSeq, memory_order_acquire);
+    if (seq & 1) return NULL;
+    sync_shared_memory();
+
+    // Offsets come from the capacity rather than the header, and every read
+    // stays within this process's mapping, whatever the scheduler is doing
+    size_t capacity = sharedData->jobCapacity;
+    size_t jobCount = sharedData->jobCount;
+    ShmLayout layout = layout_for(capacity);
+    if (layout.total > shared_size || jobCount > capacity) return NULL;
+
+    // Pages of the copy that are never written, such as the submission ring's, are never backed
+    SharedMemoryData *copy = calloc(1, layout.total);
+    if (copy == NULL) return NULL;
+    memcpy(copy, sharedData, offsetof(SharedMemoryData, submitRing));
+    memcpy(&copy->liveStats, &sharedData->liveStats, sizeof(copy->liveStats));
+#ifdef SCHED_INSTRUMENT
+    memcpy(&copy->instrument, &sharedData->instrument, sizeof(copy->instrument));
+#endif
+    const TraceRing *trace = &sharedData->traceRing;
+    uint64_t events = atomic_load_explicit(&trace->count, memory_order_acquire);
+    copy->traceRing.enabled = trace->enabled;
+    atomic_store_explicit(&copy->traceRing.count, events, memory_order_relaxed);
+    memcpy(copy->traceRing.events, trace->events,
+           (events < TRACE_RING_SIZE ? events : TRACE_RING_SIZE) * sizeof(TraceEvent));
+    for (int r = 0; r < NUM_REGIONS; r++) {
+        if (r == REGION_READY || r == REGION_HEAP || r == REGION_PID_INDEX) continue;
+        memcpy((char *)copy + layout.offset[r], (char *)sharedData + layout.offset[r], jobCount * regionEntrySize[r]);
+    }
+
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&sharedData->layoutSeq, memory_order_relaxed) != seq) {
+        free(copy);
+        return NULL;
+    }
+    copy->jobCount = jobCount;
+    apply_layout_to(copy, capacity, &layout);
+    return copy;
+}
+
+int begin_job_snapshot(void) {
+    SharedMemoryData *copy;
+    while (1) {
+        errno = 0;
+        if ((copy = copy_job_table()) != NULL) break;
+        if (errno == ENOMEM) {
+            perror("Copying the job table");
+            return -1;
+        }
+        sched_yield();  // The scheduler is growing the table, which takes it microseconds
+    }
+    liveData = sharedData;
+    liveSize = shared_size;
+    sharedData = copy;
+    shared_size = copy->segmentSize;
+    return 0;
+}
+
+void end_job_snapshot(void) {
+    free(sharedData);
+    sharedData = liveData;
+    shared_size = liveSize;
+}
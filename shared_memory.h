@@ -2,50 +2,374 @@
 #ifndef SHARED_MEMORY_H
 #define SHARED_MEMORY_H
 
+#include <stdio.h>
+#include <stdlib.h>
 #include <sys/types.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <sys/time.h>
-#include <semaphore.h>
+#include <stdalign.h>
+#include <stdatomic.h>
 
-#define MAX_PROCESSES 100
+#define INITIAL_JOB_CAPACITY 64 // Job entries mapped up front; the table doubles as needed
+#define MAX_NCPU 256        // Upper bound on simulated CPU slots
 
 #define MAX_NAME_LENGTH 256 // Maximum length for executable names
+
+#define MIN_PRIORITY 1
+#define MAX_PRIORITY 4
+#define NUM_PRIORITIES (MAX_PRIORITY - MIN_PRIORITY + 1)
+
+#define MLFQ_TOP_LEVEL (NUM_PRIORITIES - 1) // MLFQ levels share the priority rings
+#define MLFQ_BOOST_SLICES 20                // Boost all jobs to the top every 20 base slices
+
+// Stride scheduling: a job of priority p holds p * STRIDE_TICKETS_PER_PRIORITY
+// tickets, and its pass advances by STRIDE_ONE / tickets per full slice it runs
+#define STRIDE_TICKETS_PER_PRIORITY 100
+#define STRIDE_ONE (1u << 20)
+
+// Adaptive slices scale a job's quantum by 2^shift, within these bounds
+#define ADAPTIVE_MIN_SHIFT -2                 // Down to a quarter of the policy's slice
+#define ADAPTIVE_MAX_SHIFT 3                  // Up to eight times the policy's slice
+#define ADAPTIVE_GROW_USAGE 0.9               // Recent usage at or above this lengthens the slice
+#define ADAPTIVE_SHRINK_USAGE 0.5             // Recent usage below this shortens it
+
+#ifdef SCHED_INSTRUMENT
+// perf_event counters kept per job with make INSTRUMENT=1 and --perf-events
+enum { PERF_CONTEXT_SWITCHES, PERF_CYCLES, PERF_CACHE_MISSES, NUM_PERF_COUNTERS };
+#endif
+
+// Lifecycle of a job table entry, kept in the job_states() array
+enum {
+    JOB_EMPTY = 0,            // Entry not in use
+    JOB_QUEUED,               // Submitted but not launched yet
+    JOB_RUNNABLE,             // Launched and alive; running or stopped between slices
+    JOB_DONE                  // Reaped
+};
+
+// The job table is a structure of arrays. The fields the dispatch loop reads
+// on every pass each get their own densely packed array, so a scan over
+// thousands of jobs touches a few bytes per job instead of a whole record.
+enum {
+    REGION_PID,               // pid_t: the job's PID once launched, 0 before
+    REGION_STATE,             // uint8_t: JOB_* lifecycle state
+    REGION_PRIORITY,          // int8_t: submitted priority
+    REGION_LEVEL,             // int8_t: current MLFQ level, MLFQ_TOP_LEVEL being the shortest quantum
+    REGION_LAST_SLOT,         // int16_t: CPU slot the job last ran on, -1 before its first run
+    REGION_REMAINING,         // int32_t: remaining time budget in ms
+    REGION_KEY,               // uint64_t: ordering key of heap-ordered policies, smallest runs first
+    REGION_INFO,              // ProcessInfo: name and statistics
+    REGION_READY,             // uint32_t[NUM_PRIORITIES]: ready ring storage
+    REGION_HEAP,              // uint32_t: binary min-heap of ready job indices, ordered by key
+    REGION_PID_INDEX,         // PidIndexEntry[2]: open-addressing pid -> job index table
+    NUM_REGIONS
+};
+
+typedef struct {
+    pid_t pid;                // 0 marks an empty bucket
+    uint32_t index;
+} PidIndexEntry;
+
+// Per-job name and statistics, touched only on launch, resume, exit and reporting
 typedef struct {
-    size_t index;
-    int priority; 
-    pid_t pid;                // Process ID
-    char executableName[256]; // Name of the executable
-    bool isRunning;           // Is the process currently running
-    int completion_time;      // Total completion time in milliseconds
-    int wait_time;            // Wait time in milliseconds
-    time_t arrival_time;      // When the process was added
-    time_t start_time;        // When the process started executing
-    time_t end_time;          // When the process finished executing
-    int readyQueueSize;
-    int remaining_time;
-    time_t lastPausedTime;    // When the process was last paused
-    // Add any other fields as needed
+    char executableName[MAX_NAME_LENGTH]; // Name of the executable as submitted
+    char executablePath[MAX_NAME_LENGTH]; // Path resolved by the shell at submit time
+    uint64_t wait_time;       // Total time spent ready but not running, in ns
+    uint64_t arrival_time;    // When the process was submitted (CLOCK_MONOTONIC ns)
+    uint64_t start_time;      // When the process first ran (CLOCK_MONOTONIC ns), 0 before that
+    uint64_t end_time;        // When the process was reaped (CLOCK_MONOTONIC ns), 0 before that
+    uint64_t cpuUserNs;       // User CPU time reported by wait4() at exit
+    uint64_t cpuSysNs;        // System CPU time reported by wait4() at exit
+    uint64_t memoryPeakKb;    // Peak memory: the main process's max RSS, or the job's memory.peak under cgroups
+    uint64_t lastPausedTime;  // When the process was last paused or queued (CLOCK_MONOTONIC ns)
+    uint64_t spawnNs;         // Time to spawn the job and have it stopped, ready to dispatch
+    int migrations;           // Resumes on a different slot than the previous run
+    int warmResumes;          // Resumes on the same slot as the previous run
+    int slices;               // Times the job was resumed for a slice
+    int sliceMs;              // Slice the job last ran with
+    int sliceShift;           // Adaptive slices: quantum is the policy's slice scaled by 2^sliceShift
+    double sliceUsage;        // Adaptive slices: moving average of the CPU share used per slice
+    uint64_t lastCpuNs;       // Adaptive slices: CPU time used by the end of the previous slice
+    int predictedMs;          // SRTF: burst predicted at submission from the executable's history
+    int estimateMs;           // SRTF: current burst estimate, doubled each time the job outlives it
+    uint32_t gangLeader;      // Pipelines: index of the first stage of the job's gang
+    int gangSize;             // Pipelines: stages in the job's gang, 0 for a job that runs alone
+    uint64_t deadlineNs;      // When the job is due to have finished (CLOCK_MONOTONIC ns), 0 for no deadline
+    uint64_t stridePass;      // Stride: the job's virtual time, advanced by its stride for each slice it runs
+    uint64_t adoptedStartTicks; // Recovered jobs: start time of the re-adopted process, 0 for our own children
+#ifdef SCHED_INSTRUMENT
+    int64_t perfCounts[NUM_PERF_COUNTERS]; // perf_event counts over the job's slices, -1 where not counted
+#endif
 } ProcessInfo;
 
+// How the scheduler uses its NCPU slots within one round
+typedef enum {
+    DISPATCH_EVENT = 0,       // Per-slot slices; exits are picked up as they happen via epoll
+    DISPATCH_PARALLEL,        // Resume up to NCPU jobs together for one shared slice
+    DISPATCH_SERIAL,          // Give each of the round's jobs its own slice in turn
+    DISPATCH_PERCPU           // A dispatcher thread per slot with its own run queue, stealing when idle
+} DispatchMode;
+
+// Order in which ready jobs are picked
+typedef enum {
+    POLICY_RR = 0,            // Round robin within static priority levels
+    POLICY_MLFQ,              // Multi-level feedback queue with demotion and periodic boost
+    POLICY_SRTF,              // Shortest predicted remaining time first, preemptive
+    POLICY_EDF,               // Earliest deadline first, preemptive; jobs without a deadline go last
+    POLICY_STRIDE             // Stride scheduling: CPU shares in proportion to tickets drawn from priority
+} SchedPolicy;
+
+// How long each slice is
+typedef enum {
+    SLICE_FIXED = 0,          // Every job gets the policy's slice
+    SLICE_ADAPTIVE            // Scaled per job from how much of its recent slices it used
+} SliceMode;
+
+// Ring buffer of job table indices for one priority level. Its storage is
+// ready_slots(level), which holds jobCapacity entries.
+typedef struct {
+    uint32_t head;            // Next position to dequeue from
+    uint32_t tail;            // Next position to enqueue at
+    uint32_t count;           // Number of queued indices
+} ReadyRing;
+
+// A job handed from the shell to the scheduler
+typedef struct {
+    char executableName[MAX_NAME_LENGTH];
+    char executablePath[MAX_NAME_LENGTH]; // Resolved once by the shell; the scheduler never searches PATH
+    int priority;
+    uint64_t arrivalNs;       // CLOCK_MONOTONIC ns at submission
+    uint32_t argOffset;       // Arena position of the job's packed strings
+    uint32_t argBytes;        // Size of the packed strings, 0 for a job run with no arguments
+    uint16_t argc;            // The strings are argc arguments (argv[0] first), envc NAME=value
+    uint16_t envc;            // pairs, then the stdin, stdout and stderr files, "" to inherit
+    uint8_t appendStreams;    // Bit (1 << n) set if output stream n is appended to rather than truncated
+    uint16_t gangStage;       // Pipelines: the job's position in its pipeline, from 0
+    uint16_t gangSize;        // Pipelines: stages in the pipeline, 0 for a job that runs alone
+    uint32_t deadlineMs;      // Due this long after arrivalNs, 0 for no deadline
+} SubmitRecord;
+
+#define SUBMIT_RING_SIZE 1024 // Must be a power of two; holds a typical batch submission whole
+#define SUBMIT_ARENA_SIZE (1 << 20) // Must be a power of two; pages are only backed once written
+
+// Single-producer (shell) / single-consumer (scheduler) lock-free ring.
+// head and tail count records forever and are masked on access; they live on
+// separate cache lines so the two sides never contend for one.
+//
+// Argument strings travel in a byte ring alongside it, the arena. The shell
+// appends each job's block at arenaTail, never splitting it across the end,
+// and publishes it with the record. The scheduler spawns the job from the
+// block as it drains the record (copying it out only if the spawn has to be
+// retried) and then moves arenaHead past it, so the space is reused.
+typedef struct {
+    alignas(64) _Atomic uint32_t head; // Next record to consume, written by the scheduler
+    _Atomic uint32_t arenaHead;        // Arena position up to which blocks have been consumed
+    alignas(64) _Atomic uint32_t tail; // Next record to produce, written by the shell
+    uint32_t arenaTail;                // Arena position where the next block goes
+    alignas(64) SubmitRecord records[SUBMIT_RING_SIZE];
+    alignas(64) char arena[SUBMIT_ARENA_SIZE];
+} SubmitRing;
+
+// Kinds of per-slice trace events
+enum {
+    TRACE_SPAWN = 0,          // Job created and stopped, ready for its first slice
+    TRACE_RESUME,             // Slice started on a slot
+    TRACE_PREEMPT,            // Slice ended with the job still running
+    TRACE_EXIT                // Job reaped
+};
+
+// One fixed-size trace record; four fit in a cache line
+typedef struct {
+    uint64_t ns;              // Scheduler clock at the event
+    uint32_t index;           // Job table index
+    int16_t slot;             // CPU slot, -1 for events that happen off any slot
+    uint8_t type;             // TRACE_* kind
+    uint8_t reserved;
+} TraceEvent;
+
+#define TRACE_RING_SIZE 65536 // Must be a power of two; pages are only backed once written
+
+// Events the scheduler records while tracing is enabled. count only grows and
+// is published after each record is written, so another process can follow
+// the ring while the scheduler runs. Past TRACE_RING_SIZE events the oldest
+// are overwritten.
+typedef struct {
+    bool enabled;
+    alignas(64) _Atomic uint64_t count;
+    alignas(64) TraceEvent events[TRACE_RING_SIZE];
+} TraceRing;
+
+#define STATS_SUB_BUCKETS 8                    // Histogram buckets per power of two
+#define STATS_BUCKETS (36 * STATS_SUB_BUCKETS) // Covers durations up to 2^38 us, about three days
+
+// Running totals the scheduler publishes for the shell's stats command. The
+// scheduler makes seq odd before each update and even again after it; a
+// reader copies the struct and retries if seq was odd or changed meanwhile,
+// so reading never blocks or slows the scheduler.
 typedef struct {
+    alignas(64) _Atomic uint32_t seq;
+    uint64_t startNs;                        // When the scheduler started (CLOCK_MONOTONIC ns)
+    uint64_t submitted;
+    uint64_t completed;
+    uint32_t readyJobs;                      // Ready queue depth at the last update
+    uint64_t slotBusyNs[MAX_NCPU];           // Time each slot spent running jobs, finished slices only
+    uint64_t slotSince[MAX_NCPU];            // Start of the slot's current slice, 0 while idle
+    uint32_t waitHist[STATS_BUCKETS];        // Wait times of finished jobs, see stats_bucket()
+    uint32_t turnaroundHist[STATS_BUCKETS];  // Turnaround times of finished jobs
+} LiveStats;
+
+// Histogram bucket of a duration in microseconds: exact below
+// STATS_SUB_BUCKETS, then STATS_SUB_BUCKETS buckets per power of two, so a
+// bucket's values are within 12.5% of each other
+static inline int stats_bucket(uint64_t us) {
+    if (us < STATS_SUB_BUCKETS) return (int)us;
+    int octave = 63 - __builtin_clzll(us);
+    int bucket = (octave - 2) * STATS_SUB_BUCKETS + (int)((us >> (octave - 3)) & (STATS_SUB_BUCKETS - 1));
+    return bucket < STATS_BUCKETS ? bucket : STATS_BUCKETS - 1;
+}
+
+#ifdef SCHED_INSTRUMENT
+// Dispatch loop phases timed by make INSTRUMENT=1; see instrument.h
+enum {
+    PHASE_DRAIN,              // Moving submissions into the job table, spawns included
+    PHASE_PICK,               // Taking the next jobs off the ready queue
+    PHASE_SPAWN,              // Creating a job's process
+    PHASE_RESUME,             // Letting a job run: signal or cgroup thaw
+    PHASE_STOP,               // Stopping a job: signal or cgroup freeze
+    PHASE_REAP,               // Checking whether a job has exited (wait4)
+    PHASE_WAIT,               // Sleeping while jobs run, or idle
+    PHASE_LOG,                // Printing progress messages
+    NUM_PHASES
+};
+
+#define PHASE_BUCKETS 40      // Bucket b counts durations in [2^b, 2^(b+1)) ns; the last also holds longer ones
+
+// One slot's counters, a cache line apart from the next slot's
+typedef struct {
+    alignas(64) uint64_t count[NUM_PHASES];
+    uint64_t totalNs[NUM_PHASES];
+    uint32_t histogram[NUM_PHASES][PHASE_BUCKETS];
+} SlotCounters;
+
+typedef struct {
+    SlotCounters slots[MAX_NCPU];
+    SlotCounters loop;        // Phases off any slot: the main loop of per-CPU dispatch, and jobs without a slot yet
+} InstrumentBlock;
+#endif
+
+#define SHM_MAGIC 0x53534348u // "SSCH"
+
+// Instrumented builds add to the layout, so they carry a version of their own
+#ifdef SCHED_INSTRUMENT
+#define SHM_LAYOUT_VERSION (13 | 0x80000000u)
+#else
+#define SHM_LAYOUT_VERSION 13
+#endif
+
+// Header at offset 0 of the shared segment. The REGION_* arrays follow it in
+// order, each holding jobCapacity entries (the pid index holds 2 * jobCapacity).
+// The scheduler grows the segment with ftruncate/mremap when the table fills,
+// keeping layoutSeq odd while it moves the arrays. Other processes read the
+// table while the scheduler runs only through begin_job_snapshot().
+typedef struct {
+    uint32_t magic;
+    uint32_t layoutVersion;
+    size_t segmentSize;        // Bytes currently backing the segment
+    size_t jobCapacity;        // Entries in each job array
+    size_t jobCount;           // Entries in use; jobs are appended and never moved
+    size_t regionOffset[NUM_REGIONS];
+    _Atomic uint32_t layoutSeq; // Odd while grow_job_table() re-lays out the arrays
     struct {
-        ProcessInfo queue[MAX_PROCESSES];
-        int readyQueueSize;
+        ReadyRing rings[NUM_PRIORITIES]; // rings[p - MIN_PRIORITY] holds priority p
+        uint32_t heapCount;              // Indices in the ready heap, used instead of the rings by heap-ordered policies
+        unsigned int nonEmptyMask;       // Bit (p - MIN_PRIORITY) set while ring p is non-empty
+        int readyQueueSize;              // Total indices across all rings
         int submittedProcess;
     } readyQueue;
-    char executableName[MAX_NAME_LENGTH];  // Name of the executable
-    int priority;              // Priority of the process
-    pid_t pid;                 // PID of the process
-    bool isRunning;            // Status of the process (running or not)
-    int completion_time;       // Start time of the process
-    struct timeval endTime;    // End time of the process
-    int submittedProcess;
-    ProcessInfo table[MAX_PROCESSES]; 
     int NCPU;
     time_t TSLICE;
-    sem_t mutex;
+    DispatchMode dispatchMode;
+    SchedPolicy policy;
+    SliceMode sliceMode;
+    bool affinityEnabled;      // Pin each job to the core of the slot it runs on
+    int slotCore[MAX_NCPU];    // Physical core backing each CPU slot
+    uint64_t idleTimeSavedNs;  // Slot time reclaimed by refilling slots on early exit
+    _Atomic uint64_t dispatchNs;    // Wall time the dispatch loops spent outside backend waits and sleeps
+    _Atomic uint64_t slicesStarted; // Resumes of a job for a new slice
+    _Atomic bool stopRequested; // Set by the shell: a continuous scheduler returns once its jobs finish
+    SubmitRing submitRing;     // Submissions not yet drained into the job table
+    LiveStats liveStats;       // Snapshot source for the shell's stats command
+    TraceRing traceRing;       // Per-slice events for trace export
+#ifdef SCHED_INSTRUMENT
+    InstrumentBlock instrument; // Dispatch phase timings
+#endif
 } SharedMemoryData;
 
 #define SHARED_MEM_NAME "/executablename"
 
+extern SharedMemoryData *sharedData; // This process's mapping of the segment
+
+// Exit if the segment was laid out by code built with other flags, such as
+// objects left from a build with a different INSTRUMENT setting. Inline, so
+// each object that calls it checks against the layout it was compiled with.
+static inline void check_shared_layout(const SharedMemoryData *data) {
+    if (data->magic != SHM_MAGIC || data->layoutVersion != SHM_LAYOUT_VERSION) {
+        fprintf(stderr, "Shared memory layout %#x does not match this build's %#x; rebuild with make clean.\n",
+                data->layoutVersion, SHM_LAYOUT_VERSION);
+        exit(1);
+    }
+}
+extern size_t shared_size;           // Bytes of the segment this process has mapped
+
+// Create a fresh segment sized for INITIAL_JOB_CAPACITY jobs and map it
+void init_shared_memory(SharedMemoryData **sharedData, size_t *shared_size);
+
+// Same, but backed by an anonymous memfd that no other process can open (used by the simulator)
+void init_private_memory(SharedMemoryData **sharedData, size_t *shared_size);
+
+// Grow the job arrays to hold at least minCapacity entries; returns -1 on failure.
+// Only the process that created the segment may grow it.
+int grow_job_table(size_t minCapacity);
+
+// Extend this process's mapping after another process grew the segment
+void sync_shared_memory(void);
+
+// Make sharedData a private copy of the job table while the scheduler may be
+// growing it, retrying until no grow overlapped the copy, so the job_*()
+// accessors read a consistent table. The copy holds the header, the job
+// arrays, the live stats and the trace events, but neither the ready queue,
+// the pid index nor the submission ring. Returns -1, leaving sharedData the
+// live mapping, if there is no memory for it.
+int begin_job_snapshot(void);
+
+// Free the copy and make sharedData this process's mapping again
+void end_job_snapshot(void);
+
+// Record that pid now belongs to job index
+void pid_index_insert(pid_t pid, size_t index);
+
+// Job index of a launched pid, or (size_t)-1 if the pid is unknown
+size_t pid_index_lookup(pid_t pid);
+
+static inline void *job_region(int region) {
+    return (char *)sharedData + sharedData->regionOffset[region];
+}
+
+static inline pid_t *job_pids(void) { return job_region(REGION_PID); }
+static inline uint8_t *job_states(void) { return job_region(REGION_STATE); }
+static inline int8_t *job_priorities(void) { return job_region(REGION_PRIORITY); }
+static inline int8_t *job_levels(void) { return job_region(REGION_LEVEL); }
+static inline int16_t *job_last_slots(void) { return job_region(REGION_LAST_SLOT); }
+static inline int32_t *job_remaining(void) { return job_region(REGION_REMAINING); }
+static inline uint64_t *job_keys(void) { return job_region(REGION_KEY); }
+static inline uint32_t *ready_heap(void) { return job_region(REGION_HEAP); }
+
+static inline ProcessInfo *job_info(size_t index) {
+    return (ProcessInfo *)job_region(REGION_INFO) + index;
+}
+
+static inline uint32_t *ready_slots(int level) {
+    return (uint32_t *)job_region(REGION_READY) + (size_t)level * sharedData->jobCapacity;
+}
+
 #endif // SHARED_MEMORY_H
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -14,7 +15,13 @@
 #include "shared_memory.h"
 #include <sys/stat.h> // For fstat()
 #include "scheduler.h"
+#include "burst_history.h"
+#include "instrument.h"
 #include <libgen.h>
+#include <getopt.h>
+#include <sched.h>
+#include <sys/eventfd.h>
+#include <glob.h>
 
 SharedMemoryData *sharedData = NULL; // Shared data structure
 size_t shared_size;
@@ -26,9 +33,11 @@ time_t *start_times;
 double *durations;
 int ncpu;
 int tslice;
-int complete=0;
-int arrivalTime=0;
+const char *tracePath = NULL; // Chrome trace written after each scheduler run, NULL for none
+int rejectLateJobs = 0;       // EDF admission control refuses, rather than warns about, jobs that would miss deadlines
 volatile sig_atomic_t exit_requested = 0;
+pid_t schedulerPid = -1;      // The forked scheduler, -1 until it is running
+volatile sig_atomic_t interrupt_requested = 0; // Ctrl-C: show the jobs so far from the main loop
 
 #define ARG_MAX_COUNT 1024
 #define MAX_BACKGROUND_PROCESSES 100
@@ -43,9 +52,6 @@ BackgroundProcess background_processes[MAX_BACKGROUND_PROCESSES];
 int bg_process_count = 0;
 
 // Function prototypes
-void init_shared_memory(SharedMemoryData **sharedData, size_t *shared_size);
-void enqueue(SharedMemoryData *sharedData, size_t shared_size, const char *name, int priority);
-void print_shared_memory(SharedMemoryData *sharedData, size_t shared_size);
 void init_history();
 // void clean_shared_memory(SharedMemoryData *sharedData, size_t shared_size);
 void add_to_history(char *cmd, pid_t pid, double duration);
@@ -59,90 +65,713 @@ void execute_piped_commands(char *cmd_parts[], int num_parts);
 int is_blank(char *input);
 int handle_builtin(char *input);
 
-void init_shared_memory(SharedMemoryData **sharedData, size_t *shared_size) {
-    // const char* shm_name = "/process_queue";
-    int shm_fd = shm_open(SHARED_MEM_NAME, O_CREAT | O_RDWR, 0666);
-    if (shm_fd == -1) {
-        perror("shm_open");
+void cleanup() {
+    if (sharedData != NULL) {
+        // Unmapping the shared memory
+        if (munmap(sharedData, shared_size) == -1) {
+            perror("munmap");
+            exit(1);
+        }
+    }
+
+    // Unlinking the shared memory object
+    if (shm_unlink(SHARED_MEM_NAME) == -1) {
+        perror("shm_unlink");
         exit(1);
     }
+    printf("Cleanup completed, shared memory cleared.\n");
+}
+// Resolve a submitted program to the path the scheduler will spawn, the way
+// execvp would: names containing a '/' are used as given, others are searched
+// for in PATH and then in the current directory. Returns -1 if no executable
+// file is found.
+static int resolve_executable(const char *name, char *path, size_t size) {
+    struct stat st;
 
-    size_t max_processes = 10; // Adjust as needed
-    size_t shm_size = max_processes * sizeof(SharedMemoryData);
-    *shared_size = max_processes;
+    if (strchr(name, '/') != NULL) {
+        if (access(name, X_OK) != 0 || stat(name, &st) != 0 || !S_ISREG(st.st_mode)) return -1;
+        snprintf(path, size, "%s", name);
+        return 0;
+    }
 
-    if (ftruncate(shm_fd, shm_size) == -1) {
-        perror("ftruncate");
-        close(shm_fd);
-        exit(1);
+    const char *dirs = getenv("PATH");
+    if (dirs == NULL) dirs = "/usr/local/bin:/usr/bin:/bin";
+    while (1) {
+        size_t len = strcspn(dirs, ":");
+        // An empty PATH entry means the current directory
+        int n = len == 0 ? snprintf(path, size, "./%s", name)
+                         : snprintf(path, size, "%.*s/%s", (int)len, dirs, name);
+        if (n > 0 && (size_t)n < size && access(path, X_OK) == 0 &&
+            stat(path, &st) == 0 && S_ISREG(st.st_mode)) {
+            return 0;
+        }
+        if (dirs[len] == '\0') break;
+        dirs += len + 1;
     }
 
-    *sharedData = mmap(NULL, shm_size, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
-    if (*sharedData == MAP_FAILED) {
-        perror("mmap");
-        close(shm_fd);
-        exit(1);
+    snprintf(path, size, "./%s", name);
+    if (access(path, X_OK) == 0 && stat(path, &st) == 0 && S_ISREG(st.st_mode)) return 0;
+    return -1;
+}
+
+// Wake the scheduler if it is idle, waiting for a submission or a stop request
+static void wake_scheduler(void) {
+    uint64_t one = 1;
+    if (write(schedulerWakeFd, &one, sizeof(one)) == -1) perror("eventfd write");
+}
+
+#define MAX_JOB_ARGS 64   // Arguments of one submitted job, program included
+#define MAX_JOB_ENV 16    // NAME=value overrides of one submitted job
+
+// A job as written on the submit line or in a job file. The strings point into
+// the parsed text, which must outlive the submission.
+typedef struct {
+    char *argv[MAX_JOB_ARGS];  // argv[0] is the program as given
+    int argc;
+    char *env[MAX_JOB_ENV];
+    int envc;
+    char *redirect[3];         // Files for stdin, stdout and stderr, NULL to inherit
+    uint8_t appendStreams;     // As in SubmitRecord
+    int priority;
+    uint32_t deadlineMs;       // Due this long after submission, 0 for no deadline
+    char *text;                // A job file line the strings point into, owned by the spec; NULL otherwise
+} JobSpec;
+
+static int is_env_assignment(const char *word) {
+    if (!(isalpha((unsigned char)word[0]) || word[0] == '_')) return 0;
+    const char *c = word;
+    while (isalnum((unsigned char)*c) || *c == '_') c++;
+    return *c == '=';
+}
+
+// Parse "[-p N] [-d MS] [NAME=value...] program [args...] [< in] [> out | >> out] [2> err | 2>> err]".
+// -d gives the job a deadline MS milliseconds after submission.
+// The operator and its file may also be written together ("2>err"). Unless
+// the job is a pipeline stage, and without -p, a job of just a program and one
+// number reads the number as the priority, as submit always has. Returns -1,
+// with a message, if the words are not a job.
+static int parse_job_spec(char **words, int count, int defaultPriority, int stage, JobSpec *spec) {
+    memset(spec, 0, sizeof(*spec));
+    spec->priority = defaultPriority;
+    int explicitPriority = 0;
+    int i = 0;
+
+    for (; i + 1 < count && (strcmp(words[i], "-p") == 0 || strcmp(words[i], "-d") == 0); i += 2) {
+        if (words[i][1] == 'p') {
+            spec->priority = atoi(words[i + 1]);
+            explicitPriority = 1;
+            continue;
+        }
+        char *end;
+        long deadline = strtol(words[i + 1], &end, 10);
+        if (*end != '\0' || deadline <= 0 || deadline > UINT32_MAX) {
+            fprintf(stderr, "Error: Deadline '%s' is not a positive number of milliseconds.\n", words[i + 1]);
+            return -1;
+        }
+        spec->deadlineMs = (uint32_t)deadline;
+    }
+    for (; i < count && spec->argc == 0 && is_env_assignment(words[i]); i++) {
+        if (spec->envc == MAX_JOB_ENV) {
+            fprintf(stderr, "Error: At most %d environment variables per job.\n", MAX_JOB_ENV);
+            return -1;
+        }
+        spec->env[spec->envc++] = words[i];
+    }
+    for (; i < count; i++) {
+        char *word = words[i];
+        int stream = word[0] == '<' ? 0 : word[0] == '>' ? 1 : strncmp(word, "2>", 2) == 0 ? 2 : -1;
+        if (stream == -1) {
+            if (spec->argc == MAX_JOB_ARGS - 1) {
+                fprintf(stderr, "Error: At most %d arguments per job.\n", MAX_JOB_ARGS - 1);
+                return -1;
+            }
+            spec->argv[spec->argc++] = word;
+            continue;
+        }
+        word += stream == 2 ? 2 : 1;
+        if (stream > 0 && *word == '>') {
+            spec->appendStreams |= 1 << stream;
+            word++;
+        }
+        if (*word == '\0') word = i + 1 < count ? words[++i] : NULL;
+        if (word == NULL) {
+            fprintf(stderr, "Error: Redirection without a file name.\n");
+            return -1;
+        }
+        spec->redirect[stream] = word;
+    }
+    if (spec->argc == 0) {
+        fprintf(stderr, "Error: No executable specified for submit command.\n  \n");
+        return -1;
     }
 
-    close(shm_fd);
+    char *end;
+    if (!stage && !explicitPriority && spec->argc == 2 && spec->envc == 0 && spec->redirect[0] == NULL &&
+        spec->redirect[1] == NULL && spec->redirect[2] == NULL) {
+        long value = strtol(spec->argv[1], &end, 10);
+        if (*end == '\0') {
+            spec->priority = (int)value;
+            spec->argc = 1;
+        }
+    }
+    return 0;
 }
 
-void cleanup() {
-    // Clear the ProcessInfo structures in the table
-    if (sharedData != NULL) {
-        // Clear the entire table by setting it to zero
-        memset(sharedData->table, 0, sizeof(sharedData->table));
-        
-        // Alternatively, you can free any other allocated resources if needed
+// Arena bytes a job's strings take when it runs as program; 0 if the job
+// needs none, being the program alone with nothing else to pass
+static uint32_t job_block_size(const char *program, const JobSpec *spec) {
+    if (spec->argc == 1 && spec->envc == 0 && !spec->redirect[0] && !spec->redirect[1] && !spec->redirect[2]) {
+        return 0;
+    }
+    size_t bytes = strlen(program) + 1;
+    for (int i = 1; i < spec->argc; i++) bytes += strlen(spec->argv[i]) + 1;
+    for (int i = 0; i < spec->envc; i++) bytes += strlen(spec->env[i]) + 1;
+    for (int i = 0; i < 3; i++) bytes += (spec->redirect[i] ? strlen(spec->redirect[i]) : 0) + 1;
+    return bytes;
+}
 
-        // Unmapping the shared memory
-        if (munmap(sharedData, shared_size * sizeof(SharedMemoryData)) == -1) {
-            perror("munmap");
-            exit(1);
+// Arena position for a block of bytes: the current tail, or the start of the
+// arena if the block would otherwise run past its end
+static uint32_t arena_place(const SubmitRing *ring, uint32_t bytes) {
+    uint32_t offset = ring->arenaTail;
+    uint32_t used = offset & (SUBMIT_ARENA_SIZE - 1);
+    if (used + bytes > SUBMIT_ARENA_SIZE) offset += SUBMIT_ARENA_SIZE - used;
+    return offset;
+}
+
+// Whether the ring has a free record and the arena room for a block of bytes
+static int ring_has_room(SubmitRing *ring, uint32_t tail, uint32_t bytes) {
+    if (tail - atomic_load_explicit(&ring->head, memory_order_acquire) == SUBMIT_RING_SIZE) return 0;
+    if (bytes == 0) return 1;
+    uint32_t arenaHead = atomic_load_explicit(&ring->arenaHead, memory_order_acquire);
+    return arena_place(ring, bytes) + bytes - arenaHead <= SUBMIT_ARENA_SIZE;
+}
+
+// Fill the ring record at tail, and the arena with the job's strings; neither
+// is visible to the scheduler until tail is published
+static void fill_record(SubmitRing *ring, uint32_t tail, const char *program, const char *path,
+                        const JobSpec *spec, uint32_t bytes) {
+    SubmitRecord *record = &ring->records[tail & (SUBMIT_RING_SIZE - 1)];
+    strncpy(record->executableName, program, sizeof(record->executableName) - 1);
+    record->executableName[sizeof(record->executableName) - 1] = '\0';
+    strncpy(record->executablePath, path, sizeof(record->executablePath) - 1);
+    record->executablePath[sizeof(record->executablePath) - 1] = '\0';
+    record->priority = spec->priority;
+    record->arrivalNs = now_ns();
+    record->argOffset = ring->arenaTail;
+    record->argBytes = bytes;
+    record->argc = spec->argc;
+    record->envc = spec->envc;
+    record->appendStreams = spec->appendStreams;
+    record->gangStage = 0;
+    record->gangSize = 0;
+    record->deadlineMs = spec->deadlineMs;
+    if (bytes == 0) return;
+
+    record->argOffset = arena_place(ring, bytes);
+    char *next = ring->arena + (record->argOffset & (SUBMIT_ARENA_SIZE - 1));
+    next = stpcpy(next, program) + 1;
+    for (int i = 1; i < spec->argc; i++) next = stpcpy(next, spec->argv[i]) + 1;
+    for (int i = 0; i < spec->envc; i++) next = stpcpy(next, spec->env[i]) + 1;
+    for (int i = 0; i < 3; i++) next = stpcpy(next, spec->redirect[i] ? spec->redirect[i] : "") + 1;
+    ring->arenaTail = record->argOffset + bytes;
+}
+
+// Hand a job to the scheduler through the submission ring; never blocks.
+// Returns -1 if the ring or the arena is full.
+int enqueue(SharedMemoryData *sharedData, const char *path, const JobSpec *spec) {
+    SubmitRing *ring = &sharedData->submitRing;
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint32_t bytes = job_block_size(spec->argv[0], spec);
+
+    if (bytes > SUBMIT_ARENA_SIZE) {
+        fprintf(stderr, "Error: Arguments of job '%s' are too long.\n", spec->argv[0]);
+        return -1;
+    }
+    if (!ring_has_room(ring, tail, bytes)) {
+        fprintf(stderr, "Error: submission queue is full, job '%s' not queued.\n", spec->argv[0]);
+        return -1;
+    }
+    fill_record(ring, tail, spec->argv[0], path, spec, bytes);
+
+    // Publish the record; pairs with the scheduler's acquire load of tail
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    wake_scheduler();
+
+    printf("Command added to shared memory: %s with priority %d\n", spec->argv[0], spec->priority);
+    return 0;
+}
+
+// Hand a pipeline to the scheduler as a gang: one record per stage, published
+// together so the scheduler sees the whole pipeline at once. Never blocks.
+// Returns -1 if the ring or the arena cannot take every stage.
+static int enqueue_gang(const JobSpec *stages, char paths[][MAX_NAME_LENGTH], int count) {
+    SubmitRing *ring = &sharedData->submitRing;
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint32_t arenaTail = ring->arenaTail;
+
+    for (int stage = 0; stage < count; stage++) {
+        uint32_t bytes = job_block_size(stages[stage].argv[0], &stages[stage]);
+        if (bytes > SUBMIT_ARENA_SIZE || !ring_has_room(ring, tail + stage, bytes)) {
+            ring->arenaTail = arenaTail;  // Nothing was published; take the space back
+            fprintf(stderr, "Error: submission queue is full, pipeline not queued.\n");
+            return -1;
         }
+        fill_record(ring, tail + stage, stages[stage].argv[0], paths[stage], &stages[stage], bytes);
+        SubmitRecord *record = &ring->records[(tail + stage) & (SUBMIT_RING_SIZE - 1)];
+        record->priority = stages[0].priority;
+        record->deadlineMs = stages[0].deadlineMs;
+        record->gangStage = (uint16_t)stage;
+        record->gangSize = (uint16_t)count;
     }
 
-    // Unlinking the shared memory object
-    if (shm_unlink(SHARED_MEM_NAME) == -1) {
-        perror("shm_unlink");
-        exit(1);
+    atomic_store_explicit(&ring->tail, tail + count, memory_order_release);
+    wake_scheduler();
+    return 0;
+}
+
+// CPU time a job with a deadline still needs, and when it is due
+typedef struct {
+    uint64_t deadlineNs;
+    double workMs;
+} Demand;
+
+static int compare_demands(const void *a, const void *b) {
+    const Demand *x = a, *y = b;
+    return x->deadlineNs < y->deadlineNs ? -1 : x->deadlineNs > y->deadlineNs;
+}
+
+// Add a job about to be submitted as program to demands if it has a deadline.
+// Its work is its executable's predicted burst.
+static void add_demand(Demand *demands, int *count, const char *program, uint32_t deadlineMs, uint64_t now) {
+    if (deadlineMs == 0) return;
+    demands[*count].deadlineNs = now + deadlineMs * 1000000ull;
+    demands[*count].workMs = burst_history_predict(program, tslice);
+    (*count)++;
+}
+
+// EDF admission control, run before jobs with deadlines are submitted. For
+// every deadline D, the CPU time still needed by the jobs due by D, spread
+// over the NCPU slots, must fit in the time left before D; no schedule meets
+// every deadline otherwise. Jobs in the table count with the predicted time
+// the scheduler has left them in job_remaining() (one slice if they have
+// outrun their prediction), the incoming ones with their predicted bursts, so
+// the test is as good as the burst history. Only deadlines from the earliest
+// incoming one on are checked, as the incoming jobs cannot make earlier ones
+// any later. Returns -1 if the incoming jobs should be refused.
+static int admit_deadlines(const Demand *incoming, int count, uint64_t now) {
+    if (count == 0 || sharedData->policy != POLICY_EDF) return 0;
+
+    uint64_t firstIncoming = UINT64_MAX;
+    for (int i = 0; i < count; i++) {
+        if (incoming[i].deadlineNs < firstIncoming) firstIncoming = incoming[i].deadlineNs;
+        if (now + incoming[i].workMs * 1e6 > incoming[i].deadlineNs) {
+            fprintf(stderr, "%s: a job is predicted to need %.0f ms, more than its %.0f ms deadline.\n",
+                    rejectLateJobs ? "Error" : "Warning", incoming[i].workMs, (incoming[i].deadlineNs - now) / 1e6);
+            return rejectLateJobs ? -1 : 0;
+        }
+    }
+
+    // The scheduler keeps running and may grow the table meanwhile, so read a copy of it
+    if (begin_job_snapshot() == -1) return 0;
+    size_t jobCount = sharedData->jobCount;
+    Demand *demands = malloc((jobCount + count) * sizeof(Demand));
+    if (demands == NULL) {
+        perror("malloc");
+        end_job_snapshot();
+        return 0;
+    }
+    memcpy(demands, incoming, count * sizeof(Demand));
+    size_t total = count;
+    for (size_t i = 0; i < jobCount; i++) {
+        uint8_t state = job_states()[i];
+        uint64_t deadline = job_info(i)->deadlineNs;
+        if ((state != JOB_QUEUED && state != JOB_RUNNABLE) || deadline == 0) continue;
+        int32_t remaining = job_remaining()[i];
+        demands[total].deadlineNs = deadline;
+        demands[total].workMs = remaining > 0 ? remaining : tslice;
+        total++;
+    }
+    end_job_snapshot();
+    qsort(demands, total, sizeof(Demand), compare_demands);
+
+    double workMs = 0;
+    int result = 0;
+    for (size_t i = 0; i < total; i++) {
+        workMs += demands[i].workMs;
+        if (demands[i].deadlineNs < firstIncoming) continue;
+        double windowMs = demands[i].deadlineNs > now ? (demands[i].deadlineNs - now) / 1e6 : 0;
+        if (workMs / ncpu > windowMs) {
+            fprintf(stderr, "%s: deadlines would be missed: %.0f ms of work is due within %.0f ms on %d CPU slots.\n",
+                    rejectLateJobs ? "Error" : "Warning", workMs, windowMs, ncpu);
+            result = rejectLateJobs ? -1 : 0;
+            break;
+        }
+    }
+    free(demands);
+    return result;
+}
+
+// submit "<job> | <job> | ...": each stage in submit's job syntax, the first
+// one's priority and deadline applying to the whole pipeline. Every stage needs a CPU slot
+// of its own while the pipeline runs.
+static void submit_pipeline(char *text) {
+    JobSpec stages[MAX_NCPU];
+    char paths[MAX_NCPU][MAX_NAME_LENGTH];
+    char *stageText[MAX_NCPU + 1];
+    char *savePipe, *saveWord;
+    int count = 0;
+
+    if (sharedData->dispatchMode == DISPATCH_PERCPU) {
+        fprintf(stderr, "Error: Pipelines are not supported with --dispatch=percpu, which cannot co-schedule their stages.\n  \n");
+        return;
+    }
+    for (char *part = strtok_r(text, "|", &savePipe); part != NULL && count <= MAX_NCPU; part = strtok_r(NULL, "|", &savePipe)) {
+        stageText[count++] = part;
+    }
+    if (count > ncpu) {
+        fprintf(stderr, "Error: A pipeline of %d stages needs as many CPU slots; there are %d.\n  \n",
+                count, ncpu);
+        return;
+    }
+
+    for (int stage = 0; stage < count; stage++) {
+        char *words[ARG_MAX_COUNT];
+        int wordCount = 0;
+        for (char *word = strtok_r(stageText[stage], " \t", &saveWord); word != NULL && wordCount < ARG_MAX_COUNT;
+             word = strtok_r(NULL, " \t", &saveWord)) {
+            words[wordCount++] = word;
+        }
+        if (parse_job_spec(words, wordCount, 1, 1, &stages[stage]) == -1) return;
+        if (resolve_executable(stages[stage].argv[0], paths[stage], sizeof(paths[stage])) != 0) {
+            fprintf(stderr, "Error: Executable '%s' does not exist or is not accessible.\n  \n", stages[stage].argv[0]);
+            return;
+        }
+    }
+
+    Demand demands[MAX_NCPU];
+    int demandCount = 0;
+    uint64_t now = now_ns();
+    for (int stage = 0; stage < count; stage++) {
+        add_demand(demands, &demandCount, stages[stage].argv[0], stages[0].deadlineMs, now);
+    }
+    if (admit_deadlines(demands, demandCount, now) == -1) {
+        fprintf(stderr, "Pipeline not submitted.\n  \n");
+        return;
+    }
+
+    if (enqueue_gang(stages, paths, count) == 0) {
+        printf("Submitted a pipeline of %d stages with priority %d\n \n", count, stages[0].priority);
     }
-    printf("Cleanup completed, shared memory cleared.\n");
 }
-void enqueue(SharedMemoryData *sharedData, size_t shared_size, const char *name, int priority) {
-    for (size_t i = 0; i < shared_size; i++) {
-        if (sharedData->table[i].pid == 0) {  // Check if the slot is free
-            // Set up the process information
-            strncpy(sharedData->table[i].executableName, name, sizeof(sharedData->table[i].executableName) - 1);
-            sharedData->table[i].priority = priority;
-            sharedData->table[i].pid = getpid();  // Mark as queued
-            sharedData->table[i].isRunning = false;
-            sharedData->table[i].remaining_time=sharedData->TSLICE;
-            sharedData->table[i].completion_time = sharedData->TSLICE; // or another appropriate value
-            sharedData->readyQueue.queue[sharedData->readyQueue.submittedProcess] = sharedData->table[i];
-            sharedData->readyQueue.submittedProcess++;
 
-            printf("Command added to shared memory: %s with priority %d\n", name, priority);
-            break;  // Exit loop after enqueuing
+// One job of a batch submission
+typedef struct {
+    char *program;            // As given on the command line or in the job file, or a glob match
+    JobSpec *spec;            // Arguments, environment, redirections and priority
+} BatchJob;
+
+// A program checked once per batch, however many of its jobs the batch holds
+typedef struct {
+    const char *program;
+    char path[MAX_NAME_LENGTH];
+    int found;                // resolve_executable() result: 0 if the program can be spawned
+} ResolvedProgram;
+
+static uint32_t hash_program(const char *name) {
+    uint32_t hash = 2166136261u;  // FNV-1a
+    for (const unsigned char *c = (const unsigned char *)name; *c; c++) {
+        hash = (hash ^ *c) * 16777619u;
+    }
+    return hash;
+}
+
+#define SUBMIT_STALL_MS 5000  // A full ring the scheduler drains nothing from for this long is given up on
+
+// Wait until a record of bytes fits in the ring. Returns -1 if the scheduler
+// has exited, or has drained nothing for SUBMIT_STALL_MS, as when its job
+// table cannot grow.
+static int wait_for_ring_room(SubmitRing *ring, uint32_t tail, uint32_t bytes) {
+    struct timespec pause = { 0, 100000 };  // Poll interval while the ring is full
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    uint64_t lastProgress = now_ns();
+
+    while (!ring_has_room(ring, tail, bytes)) {
+        siginfo_t info = {0};
+        // WNOWAIT leaves an exited scheduler for the waitpid() at shutdown
+        if (schedulerPid > 0 && waitid(P_PID, schedulerPid, &info, WEXITED | WNOHANG | WNOWAIT) == 0 && info.si_pid != 0) {
+            fprintf(stderr, "Error: the scheduler has exited.\n");
+            return -1;
+        }
+        uint32_t drained = atomic_load_explicit(&ring->head, memory_order_acquire);
+        if (drained != head) {
+            head = drained;
+            lastProgress = now_ns();
+        } else if (now_ns() - lastProgress > SUBMIT_STALL_MS * 1000000ull) {
+            fprintf(stderr, "Error: the scheduler has taken no submissions for %d ms.\n", SUBMIT_STALL_MS);
+            return -1;
         }
+        nanosleep(&pause, NULL);
     }
+    return 0;
 }
 
+// Submit a list of jobs in one pass. Each distinct program is resolved once,
+// and records are written straight into the ring and published together with
+// a single release store and wakeup. When the ring fills, the records written
+// so far are published and the shell waits for the scheduler to drain them;
+// likewise when the arena has no room for a job's strings. The rest of the
+// batch is dropped if the scheduler stops draining.
+// Returns the number of jobs submitted; *distinct receives the number of programs checked.
+static int enqueue_batch(const BatchJob *jobs, int count, int *distinct) {
+    *distinct = 0;
+    size_t buckets = 2;
+    while (buckets < 2 * (size_t)count) buckets *= 2;
+    ResolvedProgram *programs = malloc(count * sizeof(ResolvedProgram));
+    ResolvedProgram **table = calloc(buckets, sizeof(ResolvedProgram *));
+    if (programs == NULL || table == NULL) {
+        perror("malloc");
+        free(programs);
+        free(table);
+        return 0;
+    }
 
+    SubmitRing *ring = &sharedData->submitRing;
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    int submitted = 0;
 
-void print_shared_memory(SharedMemoryData *sharedData, size_t shared_size) {
-    printf("Current processes in shared memory:\n");
-    for (size_t i = 0; i < shared_size; i++) {
-        if (sharedData[i].pid != 0) { // If PID is set
-            printf("Executable: %s, Priority: %d, PID: %d, Running: %s\n",
-                   sharedData[i].executableName,
-                   sharedData[i].priority,
-                   sharedData[i].pid,
-                   sharedData[i].isRunning ? "Yes" : "No");
+    for (int i = 0; i < count; i++) {
+        size_t bucket = hash_program(jobs[i].program) & (buckets - 1);
+        while (table[bucket] != NULL && strcmp(table[bucket]->program, jobs[i].program) != 0) {
+            bucket = (bucket + 1) & (buckets - 1);
         }
+        if (table[bucket] == NULL) {
+            ResolvedProgram *program = table[bucket] = &programs[(*distinct)++];
+            program->program = jobs[i].program;
+            program->found = resolve_executable(jobs[i].program, program->path, sizeof(program->path));
+            if (program->found != 0) {
+                fprintf(stderr, "Error: Executable '%s' does not exist or is not accessible.\n", jobs[i].program);
+            }
+        }
+        if (table[bucket]->found != 0) continue;
+
+        uint32_t bytes = job_block_size(jobs[i].program, jobs[i].spec);
+        if (bytes > SUBMIT_ARENA_SIZE) {
+            fprintf(stderr, "Error: Arguments of job '%s' are too long.\n", jobs[i].program);
+            continue;
+        }
+        if (!ring_has_room(ring, tail, bytes)) {
+            atomic_store_explicit(&ring->tail, tail, memory_order_release);
+            wake_scheduler();
+            if (wait_for_ring_room(ring, tail, bytes) == -1) break;
+        }
+        fill_record(ring, tail++, jobs[i].program, table[bucket]->path, jobs[i].spec, bytes);
+        submitted++;
     }
+
+    atomic_store_explicit(&ring->tail, tail, memory_order_release);
+    if (submitted > 0) wake_scheduler();
+    free(programs);
+    free(table);
+    return submitted;
 }
 
+// Append a job to a growing batch; returns -1 if out of memory
+static int add_batch_job(BatchJob **jobs, int *count, int *capacity, char *program, JobSpec *spec) {
+    if (*count == *capacity) {
+        int grown = *capacity ? 2 * *capacity : 64;
+        BatchJob *larger = realloc(*jobs, grown * sizeof(BatchJob));
+        if (larger == NULL) {
+            perror("realloc");
+            return -1;
+        }
+        *jobs = larger;
+        *capacity = grown;
+    }
+    (*jobs)[*count].program = program;
+    (*jobs)[*count].spec = spec;
+    (*count)++;
+    return 0;
+}
+
+// Read a job file: one job per line in submit's syntax; blank lines and lines
+// starting with '#' are skipped, as are lines that do not parse. Lines are read
+// whole with getline, however long. Each job's spec is allocated, holding its
+// line in text; the caller frees both.
+static int read_job_file(const char *path, int defaultPriority, BatchJob **jobs, int *count, int *capacity) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        perror(path);
+        return -1;
+    }
+
+    char *line = NULL;
+    size_t lineSize = 0;
+    int result = 0;
+    while (result == 0 && getline(&line, &lineSize, file) != -1) {
+        char *words[ARG_MAX_COUNT];
+        int wordCount = 0;
+        JobSpec *spec = malloc(sizeof(JobSpec));
+        char *text = strdup(line);
+        if (spec == NULL || text == NULL) {
+            perror("malloc");
+            free(spec);
+            free(text);
+            result = -1;
+            break;
+        }
+        for (char *word = strtok(text, " \t\n"); word != NULL && wordCount < ARG_MAX_COUNT; word = strtok(NULL, " \t\n")) {
+            words[wordCount++] = word;
+        }
+        if (wordCount == 0 || words[0][0] == '#' ||
+            parse_job_spec(words, wordCount, defaultPriority, 0, spec) == -1 ||
+            (result = add_batch_job(jobs, count, capacity, spec->argv[0], spec)) == -1) {
+            free(text);
+            free(spec);
+        } else {
+            spec->text = text;
+        }
+    }
+    if (result == 0 && ferror(file)) {
+        perror(path);
+        result = -1;
+    }
+    free(line);
+    fclose(file);
+    return result;
+}
+
+static int has_wildcard(const char *word) {
+    return strpbrk(word, "*?[") != NULL;
+}
+
+// submit [-p N] [-d MS] [NAME=value...] <program|pattern> [args...] [redirections]
+// submit -f <file> [N]
+// submit "<job> | <job> ..."
+//
+// See parse_job_spec() for the job syntax. A job file's lines give their own
+// priority with -p or, as a lone program and number, the old way; N is the
+// priority of the lines that do not. A program without wildcards keeps the
+// original one-job behavior; a job file or a glob pattern, which makes one job
+// per match with the same arguments, is submitted through enqueue_batch().
+// Words are separated by blanks; there is no quoting, except that the whole
+// command may be put in double quotes. A command holding a '|' is a pipeline.
+// Under EDF, jobs with deadlines pass admit_deadlines() first, all of a batch
+// or pipeline together.
+static void submit_command(char *text) {
+    char *words[ARG_MAX_COUNT];
+    int wordCount = 0;
+
+    text += strspn(text, " \t");
+    size_t length = strlen(text);
+    while (length > 0 && isspace((unsigned char)text[length - 1])) text[--length] = '\0';
+    if (length >= 2 && text[0] == '"' && text[length - 1] == '"') {
+        text[length - 1] = '\0';
+        text++;
+    }
+    if (strchr(text, '|') != NULL) {
+        submit_pipeline(text);
+        return;
+    }
+    for (char *word = strtok(text, " \t"); word != NULL && wordCount < ARG_MAX_COUNT; word = strtok(NULL, " \t")) {
+        words[wordCount++] = word;
+    }
+
+    int fromFile = wordCount > 0 && strcmp(words[0], "-f") == 0;
+    JobSpec spec;
+    if (fromFile) {
+        char *end = "";
+        long value = wordCount == 3 ? strtol(words[2], &end, 10) : 1;  // Default priority
+        if (wordCount < 2 || wordCount > 3 || *end != '\0') {
+            fprintf(stderr, "Error: Usage is submit -f <file> [priority].\n  \n");
+            return;
+        }
+        spec.priority = (int)value;
+    } else if (parse_job_spec(words, wordCount, 1, 0, &spec) == -1) {
+        return;
+    }
+
+    if (!fromFile && !has_wildcard(spec.argv[0])) {
+        char *executable_path = spec.argv[0];
+
+        // Resolve the path once here so the scheduler's launch does no PATH search
+        char resolved[MAX_NAME_LENGTH];
+        int found = resolve_executable(executable_path, resolved, sizeof(resolved));
+
+        // Get the executable name only (strip any leading directory components)
+        char *executable_name = basename(executable_path);
+        printf("Checking executable: %s\n", executable_name);
+
+        Demand demand;
+        int demandCount = 0;
+        uint64_t now = now_ns();
+        add_demand(&demand, &demandCount, spec.argv[0], spec.deadlineMs, now);
+
+        if (found != 0) {
+            fprintf(stderr, "Error: Executable '%s' does not exist or is not accessible.\n  \n", executable_name);
+        } else if (admit_deadlines(&demand, demandCount, now) == -1) {
+            fprintf(stderr, "Job '%s' not submitted.\n  \n", executable_name);
+        } else if (enqueue(sharedData, resolved, &spec) == 0) {
+            printf("Submitted command '%s' with priority %d\n \n", executable_name, spec.priority);
+        }
+        return;
+    }
+
+    uint64_t start = now_ns();
+    BatchJob *jobs = NULL;
+    int count = 0, capacity = 0;
+    glob_t matches;
+    int globbed = 0;
+    int ok = 0;
+
+    if (fromFile) {
+        ok = read_job_file(words[1], spec.priority, &jobs, &count, &capacity);
+    } else {
+        int result = glob(spec.argv[0], 0, NULL, &matches);
+        if (result == GLOB_NOMATCH) {
+            fprintf(stderr, "Error: No files match '%s'.\n", spec.argv[0]);
+        } else if (result != 0) {
+            fprintf(stderr, "Error: Could not expand '%s'.\n", spec.argv[0]);
+        }
+        globbed = result == 0 || result == GLOB_NOMATCH;
+        for (size_t m = 0; result == 0 && m < matches.gl_pathc && ok == 0; m++) {
+            ok = add_batch_job(&jobs, &count, &capacity, matches.gl_pathv[m], &spec);
+        }
+    }
+
+    Demand *demands = ok == 0 && count > 0 ? malloc(count * sizeof(Demand)) : NULL;
+    if (demands != NULL) {
+        int demandCount = 0;
+        uint64_t now = now_ns();
+        for (int i = 0; i < count; i++) {
+            add_demand(demands, &demandCount, jobs[i].program, jobs[i].spec->deadlineMs, now);
+        }
+        if (admit_deadlines(demands, demandCount, now) == -1) {
+            fprintf(stderr, "None of the %d jobs submitted.\n  \n", count);
+            ok = -1;
+        }
+        free(demands);
+    }
+
+    if (ok == 0 && count > 0) {
+        int distinct = 0;
+        int submitted = enqueue_batch(jobs, count, &distinct);
+        printf("Submitted %d of %d jobs (%d distinct executables) in %.2f ms\n \n",
+               submitted, count, distinct, (now_ns() - start) / 1e6);
+    }
+
+    if (fromFile) {
+        for (int i = 0; i < count; i++) {
+            free(jobs[i].spec->text);
+            free(jobs[i].spec);
+        }
+    }
+    if (globbed) globfree(&matches);
+    free(jobs);
+}
+
+
+
 void init_history() {
     history = calloc(HISTORY_MAXITEMS, sizeof(char *));
     pids = calloc(HISTORY_MAXITEMS, sizeof(pid_t));
@@ -199,14 +828,18 @@ void check_background_processes() {
 }
 
 void launch_command(char *cmd, size_t shared_size) {
-    // Check for pipes in the command
-    char *cmd_part = strtok(cmd, "|");
     char *cmd_parts[ARG_MAX_COUNT];
     int num_parts = 0;
 
-    while (cmd_part != NULL) {
-        cmd_parts[num_parts++] = cmd_part;
-        cmd_part = strtok(NULL, "|");
+    // Check for pipes in the command; a submitted pipeline is split by submit itself
+    if (strncmp(cmd, "submit", 6) == 0) {
+        cmd_parts[num_parts++] = cmd;
+    } else {
+        char *cmd_part = strtok(cmd, "|");
+        while (cmd_part != NULL) {
+            cmd_parts[num_parts++] = cmd_part;
+            cmd_part = strtok(NULL, "|");
+        }
     }
 
     // If there's no pipe, just execute the command normally
@@ -227,37 +860,7 @@ void execute_single_command(char *cmd, size_t shared_size) {
     
 
     if (strncmp(cmd, "submit", 6) == 0) {
-        char *executable_path = strtok(cmd + 7, " ");
-        int priority = 1;  // Default priority
-        char *priority_arg = strtok(NULL, " ");
-
-        if (priority_arg != NULL) {
-            priority = atoi(priority_arg);
-        }
-
-        if (executable_path) {
-            // Get the executable name only (strip any leading directory components)
-            char *executable_name = basename(executable_path);
-
-            // Debug output to check what we are passing to access
-            printf("Checking executable: %s\n", executable_name);
-
-            if (access(executable_name, X_OK) == 0) { // Check if the file is executable
-                enqueue(sharedData, shared_size, executable_path, priority);
-                initialize_process_schedule();
-                sharedData->readyQueue.readyQueueSize++;
-                sharedData->readyQueue.queue[complete++].arrival_time=arrivalTime;
-                printf("%d",arrivalTime);
-                arrivalTime++;
-                
-               
-                printf("Submitted command '%s' with priority %d\n \n", executable_name, priority);
-            } else {
-                fprintf(stderr, "Error: Executable '%s' does not exist or is not accessible.\n  \n", executable_name);
-            }
-        } else {
-            fprintf(stderr, "Error: No executable specified for submit command.\n  \n");
-        }
+        submit_command(cmd + 6);
         return;
     }
 
@@ -308,8 +911,9 @@ void execute_piped_commands(char *cmd_parts[], int num_parts) {
         }
     }
 
+    pid_t part_pids[num_parts];
     for (int i = 0; i < num_parts; i++) {
-        pid_t pid = fork();
+        pid_t pid = part_pids[i] = fork();
         if (pid == 0) {
             // Child process
             if (i > 0) {
@@ -343,8 +947,9 @@ void execute_piped_commands(char *cmd_parts[], int num_parts) {
         close(pipe_fds[i]);
     }
 
+    // Wait for the pipeline only: the scheduler is a child of the shell too
     for (int i = 0; i < num_parts; i++) {
-        wait(NULL);
+        if (part_pids[i] > 0) waitpid(part_pids[i], NULL, 0);
     }
 }
 
@@ -358,95 +963,333 @@ int is_blank(char *input) {
     return 1; // Blank
 }
 int handle_builtin(char *input) {
-    if (strcmp(input, "exit") == 0) {
- 
-        free(history);
-        free(pids);
-        free(start_times);
-        free(durations);
-        cleanup();
-        exit(0);
+    // Both end the session: the scheduler finishes its jobs, then shared memory is removed
+    if (strcmp(input, "exit") == 0 || strcmp(input, "clean") == 0) {
+        exit_requested = 1;
+        return 1;
     }
     if (strcmp(input, "history") == 0) {
         print_history();
         return 1;
     }
-    if (strcmp(input, "clean") == 0) { // New command to clean shared memory
-        cleanup();
+    if (strcmp(input, "stats") == 0) {
+        print_live_stats();
         return 1;
     }
     return 0;
 }
+// Only flags the interrupt: printing, allocating and re-mapping the segment
+// are not safe here, so the main loop shows the jobs instead
 void sigint_handler(int signo) {
-    if (signo == SIGINT) {
-        printf("\n  \nReceived SIGINT signal. Starting scheduler...\n \n");
-        
-        start_scheduler(sharedData, shared_size, ncpu, tslice);// Use the global shared_size
-        print_job_details();
-   
-        // sleep(10);
-        // signal(SIGINT,SIG_IGN);
+    if (signo == SIGINT) interrupt_requested = 1;
+}
+
+// The scheduler keeps running in its own process and may grow the job table
+// meanwhile, so show what it has done so far from a copy of the table
+static void show_interrupted_jobs(void) {
+    interrupt_requested = 0;
+    if (begin_job_snapshot() == -1) return;
+    printf("\n  \nReceived SIGINT signal. Jobs so far:\n \n");
+    print_job_details();
+    if (tracePath != NULL) trace_export_chrome(tracePath);
+    end_job_snapshot();
+}
+void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s <ncpu> <tslice> [--dispatch=event|parallel|serial|percpu] [--policy=rr|mlfq|srtf|edf|stride]\n"
+                    "          [--affinity=none|auto|<cpu-list>] [--slice=fixed|adaptive] [--backend=signal|cgroup]\n"
+                    "          [--admission=warn|reject] [--trace=file] [--journal=file] [--perf-events] [--verbose|--quiet]\n", prog);
+}
+
+// Map CPU slots onto cores. "auto" spreads slots over the cores this process may run on;
+// otherwise spec is a list such as "0,2,4-7" whose cores are assigned to slots in order,
+// wrapping around when there are more slots than cores. Returns -1 on a bad spec.
+int parse_affinity(const char *spec, int ncpu, int *slotCore) {
+    int cores[CPU_SETSIZE];
+    int coreCount = 0;
+
+    if (strcmp(spec, "auto") == 0) {
+        cpu_set_t allowed;
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) == -1) {
+            perror("sched_getaffinity");
+            return -1;
+        }
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &allowed)) cores[coreCount++] = cpu;
+        }
+    } else {
+        const char *p = spec;
+        while (*p) {
+            char *end;
+            long first = strtol(p, &end, 10);
+            long last = first;
+            if (end == p) return -1;
+            if (*end == '-') {
+                p = end + 1;
+                last = strtol(p, &end, 10);
+                if (end == p) return -1;
+            }
+            if (first < 0 || last >= CPU_SETSIZE || first > last) return -1;
+            for (long cpu = first; cpu <= last && coreCount < CPU_SETSIZE; cpu++) {
+                cores[coreCount++] = (int)cpu;
+            }
+            if (*end == ',') end++;
+            else if (*end != '\0') return -1;
+            p = end;
+        }
+    }
+
+    if (coreCount == 0) return -1;
+    for (int i = 0; i < ncpu; i++) {
+        slotCore[i] = cores[i % coreCount];
     }
+    return 0;
 }
+
 // Main shell loop
 int main(int argc, char *argv[]) {
     printf("inside shell\n");
-    if (argc != 3) {
-        fprintf(stderr, "Usage: %s <ncpu> <tslice>\n", argv[0]);
+
+    DispatchMode dispatchMode = DISPATCH_EVENT;
+    SchedPolicy policy = POLICY_RR;
+    SliceMode sliceMode = SLICE_FIXED;
+    int useCgroups = 0;
+    const char *affinitySpec = NULL;
+    static struct option long_options[] = {
+        {"dispatch", required_argument, NULL, 'd'},
+        {"policy", required_argument, NULL, 'p'},
+        {"affinity", required_argument, NULL, 'a'},
+        {"slice", required_argument, NULL, 's'},
+        {"backend", required_argument, NULL, 'b'},
+        {"trace", required_argument, NULL, 't'},
+        {"admission", required_argument, NULL, 'A'},
+        {"journal", required_argument, NULL, 'j'},
+        {"perf-events", no_argument, NULL, 'P'},
+        {"verbose", no_argument, NULL, 'v'},
+        {"quiet", no_argument, NULL, 'q'},
+        {NULL, 0, NULL, 0}
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "d:p:a:s:b:t:A:j:Pvq", long_options, NULL)) != -1) {
+        switch (opt) {
+        case 'd':
+            if (strcmp(optarg, "event") == 0) {
+                dispatchMode = DISPATCH_EVENT;
+            } else if (strcmp(optarg, "parallel") == 0) {
+                dispatchMode = DISPATCH_PARALLEL;
+            } else if (strcmp(optarg, "serial") == 0) {
+                dispatchMode = DISPATCH_SERIAL;
+            } else if (strcmp(optarg, "percpu") == 0) {
+                dispatchMode = DISPATCH_PERCPU;
+            } else {
+                fprintf(stderr, "Error: unknown dispatch mode '%s' (expected event, parallel, serial or percpu).\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'p':
+            if (strcmp(optarg, "rr") == 0) {
+                policy = POLICY_RR;
+            } else if (strcmp(optarg, "mlfq") == 0) {
+                policy = POLICY_MLFQ;
+            } else if (strcmp(optarg, "srtf") == 0) {
+                policy = POLICY_SRTF;
+            } else if (strcmp(optarg, "edf") == 0) {
+                policy = POLICY_EDF;
+            } else if (strcmp(optarg, "stride") == 0) {
+                policy = POLICY_STRIDE;
+            } else {
+                fprintf(stderr, "Error: unknown policy '%s' (expected rr, mlfq, srtf, edf or stride).\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'a':
+            affinitySpec = strcmp(optarg, "none") == 0 ? NULL : optarg;
+            break;
+        case 's':
+            if (strcmp(optarg, "fixed") == 0) {
+                sliceMode = SLICE_FIXED;
+            } else if (strcmp(optarg, "adaptive") == 0) {
+                sliceMode = SLICE_ADAPTIVE;
+            } else {
+                fprintf(stderr, "Error: unknown slice mode '%s' (expected fixed or adaptive).\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'b':
+            if (strcmp(optarg, "signal") == 0) {
+                useCgroups = 0;
+            } else if (strcmp(optarg, "cgroup") == 0) {
+                useCgroups = 1;
+            } else {
+                fprintf(stderr, "Error: unknown backend '%s' (expected signal or cgroup).\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 't':
+            tracePath = optarg;
+            break;
+        case 'A':
+            if (strcmp(optarg, "warn") == 0) {
+                rejectLateJobs = 0;
+            } else if (strcmp(optarg, "reject") == 0) {
+                rejectLateJobs = 1;
+            } else {
+                fprintf(stderr, "Error: unknown admission mode '%s' (expected warn or reject).\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'j':
+            journalPath = optarg;
+            break;
+        case 'P':
+#ifdef SCHED_INSTRUMENT
+            perfEventsEnabled = true;
+            break;
+#else
+            fprintf(stderr, "Error: --perf-events needs a build with make INSTRUMENT=1.\n");
+            return EXIT_FAILURE;
+#endif
+        case 'v':
+            verbosity = LOG_JOBS;
+            break;
+        case 'q':
+            verbosity = LOG_QUIET;
+            break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (argc - optind != 2) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (dispatchMode == DISPATCH_PERCPU && policy != POLICY_RR) {
+        fprintf(stderr, "Error: per-CPU dispatch runs round robin only; use --policy=rr.\n");
         return EXIT_FAILURE;
     }
 
     // Parse command line arguments
-    ncpu = atoi(argv[1]);
-    tslice = atoi(argv[2]);
+    ncpu = atoi(argv[optind]);
+    tslice = atoi(argv[optind + 1]);
 
     if (ncpu <= 0 || tslice <= 0) {
         fprintf(stderr, "Error: ncpu and tslice must be positive integers.\n");
         return EXIT_FAILURE;
     }
+    if (ncpu > MAX_NCPU) {
+        fprintf(stderr, "Error: ncpu must not exceed %d.\n", MAX_NCPU);
+        return EXIT_FAILURE;
+    }
 
-    // Set up SIGINT handler for clean shutdown
+    int slotCore[MAX_NCPU];
+    if (affinitySpec != NULL && parse_affinity(affinitySpec, ncpu, slotCore) == -1) {
+        fprintf(stderr, "Error: invalid CPU affinity '%s'.\n", affinitySpec);
+        return EXIT_FAILURE;
+    }
+
+    // Set up SIGINT handler for clean shutdown. It interrupts a pending read
+    // (no SA_RESTART), so the jobs are shown at once rather than after the next line.
     struct sigaction sa;
     sa.sa_handler = sigint_handler;
     sigemptyset(&sa.sa_mask);
     sa.sa_flags = 0;
     sigaction(SIGINT, &sa, NULL);
 
+    if (useCgroups) {
+        cgroup_backend_init();  // Falls back to signals by itself
+    }
+
+    // SRTF and EDF remember each executable's bursts across sessions
+    static char historyPath[4096];
+    const char *home = getenv("HOME");
+    if (getenv(BURST_HISTORY_ENV) != NULL) {
+        burstHistoryPath = getenv(BURST_HISTORY_ENV);
+    } else if (home != NULL) {
+        snprintf(historyPath, sizeof(historyPath), "%s/%s", home, BURST_HISTORY_FILE);
+        burstHistoryPath = historyPath;
+    }
+
     // Initialize shared memory
     init_shared_memory(&sharedData, &shared_size);
+    check_shared_layout(sharedData);
     sharedData->NCPU=ncpu;
     sharedData->TSLICE=tslice;
+    sharedData->dispatchMode=dispatchMode;
+    sharedData->policy=policy;
+    sharedData->sliceMode = sliceMode;
+    sharedData->affinityEnabled = affinitySpec != NULL;
+    sharedData->traceRing.enabled = tracePath != NULL;
+    if (sharedData->affinityEnabled) {
+        memcpy(sharedData->slotCore, slotCore, ncpu * sizeof(int));
+    }
+    initialize_process_schedule();
+
+    // The scheduler runs continuously and sleeps on this eventfd while idle
+    schedulerWakeFd = eventfd(0, EFD_CLOEXEC);
+    if (schedulerWakeFd == -1) {
+        perror("eventfd");
+        return EXIT_FAILURE;
+    }
+
     // Fork a new process to run the scheduler
+    fflush(stdout);
     pid_t pid = fork();
     if (pid < 0) {
         perror("Fork failed");
         return EXIT_FAILURE;
     } else if (pid == 0) {
-        // Child process: Run the scheduler
-    
-        initialize_process_schedule();
+        // Child process: run the scheduler in its own process group, so Ctrl-C
+        // at the shell reaches neither it nor its jobs
+        setpgid(0, 0);
+        signal(SIGINT, SIG_IGN);
+        setvbuf(stdout, NULL, _IOLBF, 0);
+        start_scheduler(sharedData, shared_size, ncpu, tslice);
+        cgroup_backend_release();
         exit(EXIT_SUCCESS); // Ensure child process exits after scheduler
     } else {
         // Parent process: Run the shell
+        schedulerPid = pid;
         init_history();
 
+        // EDF admission control predicts bursts from the history as it stood at startup
+        if (policy == POLICY_EDF && burstHistoryPath != NULL) {
+            burst_history_load(burstHistoryPath);
+        }
+
         char input[1024];
         while (!exit_requested) {
+            if (interrupt_requested) show_interrupted_jobs();
             printf("shell> ");
-            if (fgets(input, sizeof(input), stdin) == NULL) break;
+            fflush(stdout);
+            errno = 0;
+            if (fgets(input, sizeof(input), stdin) == NULL) {
+                if (errno == EINTR && !feof(stdin)) {
+                    clearerr(stdin);  // Interrupted by Ctrl-C; keep reading
+                    continue;
+                }
+                break;
+            }
             input[strcspn(input, "\n")] = 0; // Remove newline
 
             if (is_blank(input)) continue;
-            if (handle_builtin(input)) break;
+            if (handle_builtin(input)) continue;
 
             launch_command(input, shared_size); // Send command to scheduler
         }
 
-        // Wait for the scheduler to finish (optional, if you want synchronous exit)
+        // Let the scheduler finish the jobs already submitted, then stop
+        atomic_store(&sharedData->stopRequested, true);
+        wake_scheduler();
         waitpid(pid, NULL, 0);
 
         // Clean up
         print_job_details();
+        if (tracePath != NULL) trace_export_chrome(tracePath);
+        free(history);
+        free(pids);
+        free(start_times);
+        free(durations);
         cleanup();
         printf("Exiting shell\n");
     }
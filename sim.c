@@ -0,0 +1,363 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <stdatomic.h>
+#include "shared_memory.h"
+#include "scheduler.h"
+
+// Deterministic discrete-event simulator. Replays a trace of synthetic jobs
+// through the scheduler's own policies and dispatch loops, with a virtual
+// clock in place of CLOCK_MONOTONIC and simulated CPU bursts in place of
+// processes. Nothing depends on wall-clock time, so a run's output is
+// identical every time and a large trace finishes in seconds.
+//
+// Trace format, one job per line (blank lines and lines starting with '#' are skipped):
+//     <arrival-ms> <burst-ms> [priority [name [deadline-ms]]]
+// where the deadline, if given, is relative to the job's arrival.
+
+SharedMemoryData *sharedData = NULL;
+size_t shared_size;
+
+void initialize_process_schedule();
+void print_job_details();
+
+#define SIM_EPOCH_NS 1000000000ull  // Virtual time of trace offset 0; job timestamps must be non-zero
+
+typedef struct {
+    uint64_t arrivalNs;
+    uint64_t burstNs;         // CPU time the job needs before it exits
+    uint64_t consumedNs;      // CPU time it has had in finished runs
+    uint64_t runningSince;    // Virtual time of the current run, 0 while stopped
+    size_t line;              // Trace line, to keep file order among equal arrivals
+    int priority;
+    uint32_t deadlineMs;      // Relative to arrival, 0 for no deadline
+    char *name;               // NULL for an unnamed job
+} SimJob;
+
+static SimJob *jobs;
+static size_t jobCount;
+static size_t nextArrival;    // First job not yet handed to the scheduler
+static uint64_t simNow = SIM_EPOCH_NS;
+
+// Jobs currently resumed, at most one per CPU slot
+static size_t running[MAX_NCPU];
+static int runningCount;
+
+static int compare_arrivals(const void *a, const void *b) {
+    const SimJob *x = a, *y = b;
+    if (x->arrivalNs != y->arrivalNs) return x->arrivalNs < y->arrivalNs ? -1 : 1;
+    return x->line < y->line ? -1 : 1;
+}
+
+// Load and sort a trace; returns -1 on a malformed line
+static int load_trace(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        perror(path);
+        return -1;
+    }
+
+    size_t capacity = 1024;
+    jobs = malloc(capacity * sizeof(SimJob));
+    char line[512];
+    size_t lineNo = 0;
+    while (jobs != NULL && fgets(line, sizeof(line), file) != NULL) {
+        lineNo++;
+        char *text = line + strspn(line, " \t");
+        if (*text == '#' || *text == '\n' || *text == '\0') continue;
+
+        double arrivalMs, burstMs;
+        int priority = MIN_PRIORITY;
+        unsigned int deadlineMs = 0;
+        char name[MAX_NAME_LENGTH];
+        name[0] = '\0';
+        int fields = sscanf(text, "%lf %lf %d %255s %u", &arrivalMs, &burstMs, &priority, name, &deadlineMs);
+        if (fields < 2 || arrivalMs < 0 || burstMs <= 0) {
+            fprintf(stderr, "%s:%zu: expected <arrival-ms> <burst-ms> [priority [name [deadline-ms]]]\n", path, lineNo);
+            fclose(file);
+            return -1;
+        }
+
+        if (jobCount == capacity) {
+            capacity *= 2;
+            SimJob *grown = realloc(jobs, capacity * sizeof(SimJob));
+            if (grown == NULL) break;
+            jobs = grown;
+        }
+        SimJob *job = &jobs[jobCount++];
+        job->arrivalNs = SIM_EPOCH_NS + (uint64_t)(arrivalMs * 1e6 + 0.5);
+        job->burstNs = (uint64_t)(burstMs * 1e6 + 0.5);
+        job->consumedNs = 0;
+        job->runningSince = 0;
+        job->line = lineNo;
+        job->priority = priority;
+        job->deadlineMs = deadlineMs;
+        job->name = name[0] ? strdup(name) : NULL;
+    }
+    fclose(file);
+    if (jobs == NULL) {
+        perror("malloc");
+        return -1;
+    }
+
+    qsort(jobs, jobCount, sizeof(SimJob), compare_arrivals);
+    return 0;
+}
+
+// Hand every job that has arrived by now to the scheduler through the
+// submission ring, exactly as the shell would. Jobs enter the job table in
+// this order, so job table index i is jobs[i].
+static void publish_arrivals(void) {
+    SubmitRing *ring = &sharedData->submitRing;
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+    for (; nextArrival < jobCount && jobs[nextArrival].arrivalNs <= simNow; nextArrival++) {
+        if (tail - head == SUBMIT_RING_SIZE) break;  // The rest go after the next drain
+
+        const SimJob *job = &jobs[nextArrival];
+        SubmitRecord *record = &ring->records[tail & (SUBMIT_RING_SIZE - 1)];
+        if (job->name != NULL) {
+            snprintf(record->executableName, sizeof(record->executableName), "%s", job->name);
+        } else {
+            snprintf(record->executableName, sizeof(record->executableName), "job%zu", nextArrival);
+        }
+        record->executablePath[0] = '\0';
+        record->priority = job->priority;
+        record->arrivalNs = job->arrivalNs;
+        record->argBytes = 0;  // Spawned with no arguments
+        record->gangSize = 0;
+        record->deadlineMs = job->deadlineMs;
+        tail++;
+    }
+    atomic_store_explicit(&ring->tail, tail, memory_order_release);
+}
+
+static void advance_to(uint64_t time) {
+    if (time > simNow) simNow = time;
+    publish_arrivals();
+}
+
+static uint64_t sim_now(void) {
+    return simNow;
+}
+
+static uint64_t sim_next_arrival(void) {
+    return nextArrival < jobCount ? jobs[nextArrival].arrivalNs : UINT64_MAX;
+}
+
+static int sim_launch(size_t index) {
+    job_pids()[index] = (pid_t)(index + 1);  // Placeholder PID, only used to label the job
+    job_states()[index] = JOB_RUNNABLE;
+    pid_index_insert(job_pids()[index], index);
+    return 0;
+}
+
+static void sim_resume(size_t index) {
+    jobs[index].runningSince = simNow;
+    running[runningCount++] = index;
+}
+
+// Take a job off the CPU, crediting the CPU time it used in this run
+static void settle(size_t index) {
+    SimJob *job = &jobs[index];
+    if (job->runningSince == 0) return;
+
+    job->consumedNs += simNow - job->runningSince;
+    if (job->consumedNs > job->burstNs) job->consumedNs = job->burstNs;
+    job->runningSince = 0;
+    for (int i = 0; i < runningCount; i++) {
+        if (running[i] == index) {
+            running[i] = running[--runningCount];
+            break;
+        }
+    }
+}
+
+static void sim_stop(size_t index) {
+    settle(index);
+}
+
+static int sim_reap(size_t index, int *status, struct rusage *usage) {
+    SimJob *job = &jobs[index];
+    uint64_t used = job->consumedNs;
+    if (job->runningSince != 0) used += simNow - job->runningSince;
+    if (used < job->burstNs) return 0;
+
+    settle(index);
+    *status = 0;  // Exited with status 0
+    memset(usage, 0, sizeof(*usage));
+    usage->ru_utime.tv_sec = job->burstNs / 1000000000ull;
+    usage->ru_utime.tv_usec = job->burstNs % 1000000000ull / 1000;
+    return 1;
+}
+
+static uint64_t sim_cpu_time(size_t index) {
+    const SimJob *job = &jobs[index];
+    return job->consumedNs + (job->runningSince != 0 ? simNow - job->runningSince : 0);
+}
+
+static void sim_sleep_until(uint64_t deadline) {
+    advance_to(deadline);
+}
+
+// Jump to the deadline, or to the first running job's exit if that comes sooner
+static void sim_wait_event(uint64_t deadline) {
+    uint64_t next = deadline;
+    for (int i = 0; i < runningCount; i++) {
+        const SimJob *job = &jobs[running[i]];
+        uint64_t exitAt = job->runningSince + (job->burstNs - job->consumedNs);
+        if (exitAt < next) next = exitAt;
+    }
+    advance_to(next);
+}
+
+// Virtual time needs no event sources: sim_wait_event computes the next exit itself
+static void sim_no_events(void) {
+}
+
+static void sim_watch(int slot, size_t index) {
+}
+
+static void sim_unwatch(int slot) {
+}
+
+static const SchedBackend simBackend = {
+    .now = sim_now,
+    .next_arrival = sim_next_arrival,
+    .launch = sim_launch,
+    .resume = sim_resume,
+    .stop = sim_stop,
+    .reap = sim_reap,
+    .cpu_time = sim_cpu_time,
+    .sleep_until = sim_sleep_until,
+    .open_events = sim_no_events,
+    .watch = sim_watch,
+    .unwatch = sim_unwatch,
+    .wait_event = sim_wait_event,
+    .close_events = sim_no_events,
+};
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s <ncpu> <tslice> <trace-file> [--dispatch=event|parallel|serial] [--policy=rr|mlfq|srtf|edf|stride]\n"
+                    "          [--slice=fixed|adaptive] [--history=file] [--trace=file] [--verbose|--quiet]\n", prog);
+}
+
+int main(int argc, char *argv[]) {
+    DispatchMode dispatchMode = DISPATCH_EVENT;
+    SchedPolicy policy = POLICY_RR;
+    SliceMode sliceMode = SLICE_FIXED;
+    const char *tracePath = NULL;
+    static struct option long_options[] = {
+        {"dispatch", required_argument, NULL, 'd'},
+        {"policy", required_argument, NULL, 'p'},
+        {"slice", required_argument, NULL, 's'},
+        {"history", required_argument, NULL, 'h'},
+        {"trace", required_argument, NULL, 't'},
+        {"verbose", no_argument, NULL, 'v'},
+        {"quiet", no_argument, NULL, 'q'},
+        {NULL, 0, NULL, 0}
+    };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "d:p:s:h:t:vq", long_options, NULL)) != -1) {
+        switch (opt) {
+        case 'd':
+            if (strcmp(optarg, "event") == 0) {
+                dispatchMode = DISPATCH_EVENT;
+            } else if (strcmp(optarg, "parallel") == 0) {
+                dispatchMode = DISPATCH_PARALLEL;
+            } else if (strcmp(optarg, "serial") == 0) {
+                dispatchMode = DISPATCH_SERIAL;
+            } else {
+                fprintf(stderr, "Error: unknown dispatch mode '%s' (expected event, parallel or serial).\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'p':
+            if (strcmp(optarg, "rr") == 0) {
+                policy = POLICY_RR;
+            } else if (strcmp(optarg, "mlfq") == 0) {
+                policy = POLICY_MLFQ;
+            } else if (strcmp(optarg, "srtf") == 0) {
+                policy = POLICY_SRTF;
+            } else if (strcmp(optarg, "edf") == 0) {
+                policy = POLICY_EDF;
+            } else if (strcmp(optarg, "stride") == 0) {
+                policy = POLICY_STRIDE;
+            } else {
+                fprintf(stderr, "Error: unknown policy '%s' (expected rr, mlfq, srtf, edf or stride).\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 's':
+            if (strcmp(optarg, "fixed") == 0) {
+                sliceMode = SLICE_FIXED;
+            } else if (strcmp(optarg, "adaptive") == 0) {
+                sliceMode = SLICE_ADAPTIVE;
+            } else {
+                fprintf(stderr, "Error: unknown slice mode '%s' (expected fixed or adaptive).\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'h':
+            burstHistoryPath = optarg;
+            break;
+        case 't':
+            tracePath = optarg;
+            break;
+        case 'v':
+            verbosity = LOG_JOBS;
+            break;
+        case 'q':
+            verbosity = LOG_QUIET;
+            break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (argc - optind != 3) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    int ncpu = atoi(argv[optind]);
+    int tslice = atoi(argv[optind + 1]);
+    if (ncpu <= 0 || tslice <= 0) {
+        fprintf(stderr, "Error: ncpu and tslice must be positive integers.\n");
+        return EXIT_FAILURE;
+    }
+    if (ncpu > MAX_NCPU) {
+        fprintf(stderr, "Error: ncpu must not exceed %d.\n", MAX_NCPU);
+        return EXIT_FAILURE;
+    }
+    if (load_trace(argv[optind + 2]) == -1) {
+        return EXIT_FAILURE;
+    }
+
+    init_private_memory(&sharedData, &shared_size);
+    check_shared_layout(sharedData);
+    sharedData->NCPU = ncpu;
+    sharedData->TSLICE = tslice;
+    sharedData->dispatchMode = dispatchMode;
+    sharedData->policy = policy;
+    sharedData->sliceMode = sliceMode;
+    sharedData->affinityEnabled = false;
+    sharedData->traceRing.enabled = tracePath != NULL;
+    initialize_process_schedule();
+
+    schedBackend = &simBackend;
+    publish_arrivals();
+
+    log_at(LOG_SUMMARY, "Simulating %zu jobs from %s\n", jobCount, argv[optind + 2]);
+    start_scheduler(sharedData, shared_size, ncpu, tslice);
+    print_job_details();
+    printf("Simulated time: %.2f ms\n", (simNow - SIM_EPOCH_NS) / 1e6);
+    if (tracePath != NULL && trace_export_chrome(tracePath) == -1) {
+        return EXIT_FAILURE;
+    }
+    return 0;
+}
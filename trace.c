@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "shared_memory.h"
+#include "scheduler.h"
+
+// Chrome trace / Perfetto export of the trace ring. Every CPU slot becomes a
+// thread track holding one span per slice, from the job's resume to its
+// preemption or exit, so chrome://tracing or ui.perfetto.dev shows a Gantt
+// chart of which job ran where. Spawns go on a track of their own after the
+// slots, and exits are instant markers.
+
+typedef struct {
+    uint64_t since;           // Resume time of the job's open slice, 0 when none is open
+    int16_t slot;
+} OpenSlice;
+
+// Write s as a JSON string literal
+static void json_string(FILE *file, const char *s) {
+    fputc('"', file);
+    for (const unsigned char *c = (const unsigned char *)s; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            fprintf(file, "\\%c", *c);
+        } else if (*c < 0x20) {
+            fprintf(file, "\\u%04x", *c);
+        } else {
+            fputc(*c, file);
+        }
+    }
+    fputc('"', file);
+}
+
+// Trace timestamps are microseconds from the start of the trace
+static double trace_us(uint64_t ns, uint64_t base) {
+    return (ns - base) / 1e3;
+}
+
+// A complete ("X") event named after the job
+static void write_span(FILE *file, const char *category, size_t index,
+                       int tid, uint64_t start, uint64_t end, uint64_t base) {
+    fprintf(file, ",\n{\"name\":");
+    json_string(file, job_info(index)->executableName);
+    fprintf(file, ",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,"
+            "\"args\":{\"job\":%zu,\"pid\":%d}}",
+            category, tid, trace_us(start, base), (end - start) / 1e3, index, job_pids()[index]);
+}
+
+int trace_export_chrome(const char *path) {
+    sync_shared_memory();  // The scheduler may have grown the job table
+    TraceRing *trace = &sharedData->traceRing;
+    uint64_t count = atomic_load_explicit(&trace->count, memory_order_acquire);
+    uint64_t first = count > TRACE_RING_SIZE ? count - TRACE_RING_SIZE : 0;
+    int ncpu = sharedData->NCPU;
+    int spawnTid = ncpu;
+
+    if (first > 0) {
+        fprintf(stderr, "Trace ring overflowed; the oldest %llu events were dropped.\n",
+                (unsigned long long)first);
+    }
+
+    OpenSlice *open = calloc(sharedData->jobCount ? sharedData->jobCount : 1, sizeof(OpenSlice));
+    FILE *file = fopen(path, "w");
+    if (open == NULL || file == NULL) {
+        perror(path);
+        free(open);
+        if (file != NULL) fclose(file);
+        return -1;
+    }
+
+    // Spawns are drawn as spans ending at their event, so the trace starts at the earliest spawn start
+    uint64_t base = UINT64_MAX;
+    for (uint64_t i = first; i < count; i++) {
+        const TraceEvent *event = &trace->events[i & (TRACE_RING_SIZE - 1)];
+        uint64_t start = event->ns;
+        if (event->type == TRACE_SPAWN) start -= job_info(event->index)->spawnNs;
+        if (start < base) base = start;
+    }
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"SimpleScheduler\"}}");
+    for (int slot = 0; slot < ncpu; slot++) {
+        fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"CPU slot %d\"}}",
+                slot, slot);
+    }
+    fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"Spawn\"}}", spawnTid);
+
+    for (uint64_t i = first; i < count; i++) {
+        const TraceEvent *event = &trace->events[i & (TRACE_RING_SIZE - 1)];
+        size_t index = event->index;
+        if (index >= sharedData->jobCount) continue;
+        OpenSlice *slice = &open[index];
+
+        switch (event->type) {
+        case TRACE_SPAWN:
+            write_span(file, "spawn", index, spawnTid,
+                       event->ns - job_info(index)->spawnNs, event->ns, base);
+            break;
+        case TRACE_RESUME:
+            slice->since = event->ns;
+            slice->slot = event->slot;
+            break;
+        case TRACE_PREEMPT:
+        case TRACE_EXIT:
+            // A slice whose resume was overwritten in the ring is left out
+            if (slice->since != 0) {
+                write_span(file, "slice", index, slice->slot, slice->since, event->ns, base);
+                slice->since = 0;
+            }
+            if (event->type == TRACE_EXIT) {
+                fprintf(file, ",\n{\"name\":\"exit\",\"cat\":\"exit\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,"
+                        "\"tid\":%d,\"ts\":%.3f,\"args\":{\"job\":%zu}}",
+                        event->slot >= 0 ? event->slot : spawnTid, trace_us(event->ns, base), index);
+            }
+            break;
+        }
+    }
+    fprintf(file, "\n]}\n");
+    free(open);
+
+    if (fclose(file) != 0) {
+        perror(path);
+        return -1;
+    }
+    log_at(LOG_SUMMARY, "Wrote %llu trace events to %s\n", (unsigned long long)(count - first), path);
+    return 0;
+}